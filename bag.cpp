@@ -30,11 +30,13 @@ using namespace std;
 using namespace Quackle;
 
 Bag::Bag()
+	: m_drawInOrder(false)
 {
 	prepareFullBag();
 }
 
 Bag::Bag(const LetterString &contents)
+	: m_drawInOrder(false)
 {
 	toss(contents);
 }
@@ -68,14 +70,22 @@ void Bag::toss(const LetterString &letters)
 {
 	const LetterString::const_iterator end(letters.end());
 	for (LetterString::const_iterator it = letters.begin(); it != end; ++it)
-		m_tiles.push_back(*it);
+		tossLetter(*it);
 }
 
 void Bag::toss(const LongLetterString &letters)
 {
 	const LongLetterString::const_iterator end(letters.end());
 	for (LongLetterString::const_iterator it = letters.begin(); it != end; ++it)
-		m_tiles.push_back(*it);
+		tossLetter(*it);
+}
+
+void Bag::tossLetter(Letter letter)
+{
+	if (m_drawInOrder)
+		m_tiles.insert(m_tiles.begin() + DataManager::self()->randomInteger(0, (int)m_tiles.size()), letter);
+	else
+		m_tiles.push_back(letter);
 }
 
 Letter Bag::erase(int pos)
@@ -101,6 +111,9 @@ void Bag::exch(const Move &move, Rack &rack)
 
 Letter Bag::pluck()
 {
+	if (m_drawInOrder)
+		return erase((int)m_tiles.size() - 1);
+
 	return erase(DataManager::self()->randomInteger(0, (int)m_tiles.size() - 1));
 }
 
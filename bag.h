@@ -37,9 +37,17 @@ public:
 
 	void exch(const Move &move, Rack &rack);
 
-	// removes and returns a random letter from bag
+	// removes and returns a random letter from bag, or the
+	// last one if drawing in order
 	Letter pluck();
 
+	// When drawing in order, tiles come out from the back of tiles()
+	// as it stands, and tossed tiles go in at random places. Bags
+	// that start out in the same order then draw the same tiles no
+	// matter what was tossed into them.
+	void setDrawInOrder(bool drawInOrder);
+	bool drawInOrder() const;
+
 	// returns true if all letters were in the bag before
 	// and were removed
 	bool removeLetters(const LetterString &letters);
@@ -98,9 +106,23 @@ private:
 	// remove letter from the bag
 	Letter erase(int pos);
 
+	// put letter in the bag where it will next be drawn from
+	void tossLetter(Letter letter);
+
 	LongLetterString m_tiles;
+	bool m_drawInOrder;
 };
 
+inline void Bag::setDrawInOrder(bool drawInOrder)
+{
+	m_drawInOrder = drawInOrder;
+}
+
+inline bool Bag::drawInOrder() const
+{
+	return m_drawInOrder;
+}
+
 inline void Bag::toss(const Rack &rack)
 {
 	toss(rack.tiles());
@@ -16,6 +16,7 @@
  *  along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstring>
 #include <sstream>
 #include <iostream>
 
@@ -39,6 +40,12 @@ inline int wordMultiplier(int row, int column)
 	return QUACKLE_BOARD_PARAMETERS->wordMultiplier(row, column);
 }
 
+// the squares on either side of square i of a row or column
+inline uint64_t neighbourBits(int i)
+{
+	return (uint64_t(1) << (i + 1)) | ((uint64_t(1) << i) >> 1);
+}
+
 Board::Board()
     : m_width(QUACKLE_BOARD_PARAMETERS->width()), 
       m_height(QUACKLE_BOARD_PARAMETERS->height()), 
@@ -51,6 +58,44 @@ Board::Board(int width, int height)
 {
 }
 
+Board::Board(const Board &board)
+{
+	copyFrom(board);
+}
+
+Board &Board::operator=(const Board &board)
+{
+	if (this != &board)
+		copyFrom(board);
+	return *this;
+}
+
+void Board::copyFrom(const Board &board)
+{
+	m_width = board.m_width;
+	m_height = board.m_height;
+	m_empty = board.m_empty;
+
+	const int squares = m_width * m_height;
+	memcpy(m_letters, board.m_letters, squares * sizeof(m_letters[0]));
+	memcpy(m_isBlank, board.m_isBlank, squares * sizeof(m_isBlank[0]));
+	memcpy(m_isBritish, board.m_isBritish, squares * sizeof(m_isBritish[0]));
+	memcpy(m_vcross, board.m_vcross, squares * sizeof(m_vcross[0]));
+	memcpy(m_hcross, board.m_hcross, squares * sizeof(m_hcross[0]));
+
+	memcpy(m_occupied[0], board.m_occupied[0], m_height * sizeof(m_occupied[0][0]));
+	memcpy(m_occupied[1], board.m_occupied[1], m_width * sizeof(m_occupied[1][0]));
+
+	for (int direction = 0; direction < 2; ++direction)
+	{
+		memcpy(m_gaddagAnchors[direction], board.m_gaddagAnchors[direction], m_height * sizeof(m_gaddagAnchors[0][0]));
+		memcpy(m_dawgAnchors[direction], board.m_dawgAnchors[direction], m_height * sizeof(m_dawgAnchors[0][0]));
+		memcpy(m_gaddagAnchorLimits[direction], board.m_gaddagAnchorLimits[direction], squares * sizeof(m_gaddagAnchorLimits[0][0]));
+		memcpy(m_dawgAnchorLimits[direction], board.m_dawgAnchorLimits[direction], squares * sizeof(m_dawgAnchorLimits[0][0]));
+		memcpy(m_hookScores[direction], board.m_hookScores[direction], squares * sizeof(m_hookScores[0][0]));
+	}
+}
+
 Bag Board::tilesOnBoard() const
 {
 	Bag ret;
@@ -60,10 +105,10 @@ Bag Board::tilesOnBoard() const
 	{
 		for (int col = 0; col < m_width; col++)
 		{
-			if (m_letters[row][col] != QUACKLE_NULL_MARK)
+			if (m_letters[square(row, col)] != QUACKLE_NULL_MARK)
 			{
 				LetterString letters;
-				letters += m_isBlank[row][col]? QUACKLE_BLANK_MARK : m_letters[row][col];
+				letters += m_isBlank[square(row, col)]? QUACKLE_BLANK_MARK : m_letters[square(row, col)];
 				ret.toss(letters);
 			}
 		}
@@ -78,34 +123,36 @@ Bag Board::tilesNotOnBoard() const
 
 	for (int row = 0; row < m_height; row++)
 		for (int col = 0; col < m_width; col++)
-			if (m_letters[row][col] != QUACKLE_NULL_MARK)
-				ret.removeLetter(m_isBlank[row][col]? QUACKLE_BLANK_MARK : m_letters[row][col]);
+			if (m_letters[square(row, col)] != QUACKLE_NULL_MARK)
+				ret.removeLetter(m_isBlank[square(row, col)]? QUACKLE_BLANK_MARK : m_letters[square(row, col)]);
 
 	return ret;
 }
 
 bool Board::isConnected(const Move &move) const
 {
-	bool ret = false;
-
 	if (m_empty)
 		return true;
 
-	if (move.action == Move::Place)
-	{
-		int i = 0;
-		for (const auto& it : move.tiles())
-		{
-			const int row = move.horizontal? move.startrow : i + move.startrow;
-			const int column = move.horizontal? i + move.startcol : move.startcol;
+	if (move.action != Move::Place || move.tiles().empty())
+		return false;
 
-			if (isNonempty(row, column) || (row > 0 && isNonempty(row - 1, column)) || (column > 0 && isNonempty(row, column - 1)) || (row < m_height - 1 && isNonempty(row + 1, column)) || (column < m_width - 1 && isNonempty(row, column + 1)))
-				return true;
-			i++;
-		}
-	}
+	const int direction = move.horizontal? 0 : 1;
+	const int line = move.horizontal? move.startrow : move.startcol;
+	const int first = move.horizontal? move.startcol : move.startrow;
+	const int lineCount = move.horizontal? m_height : m_width;
 
-	return ret;
+	// the squares of the move and the ones just before and after it
+	const uint64_t span = ((uint64_t(1) << move.tiles().length()) - 1) << first;
+	const uint64_t ends = (span << 1) | (span >> 1);
+
+	uint64_t hooks = 0;
+	if (line > 0)
+		hooks |= m_occupied[direction][line - 1];
+	if (line < lineCount - 1)
+		hooks |= m_occupied[direction][line + 1];
+
+	return (m_occupied[direction][line] & (span | ends)) || (hooks & span);
 }
 
 bool Board::isUnacceptableOpeningMove(const Move &move) const
@@ -141,25 +188,25 @@ void Board::updateBritishness()
 		{
 			bool isBritish = false;
 
-			if (m_letters[row][col] != QUACKLE_NULL_MARK)
+			if (m_letters[square(row, col)] != QUACKLE_NULL_MARK)
 			{
 				word.clear();
-				word += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(m_letters[row][col]);
+				word += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(m_letters[square(row, col)]);
 
 				for (int j = row - 1; j >= 0; --j)
 				{
-					if (m_letters[j][col] == QUACKLE_NULL_MARK)
+					if (m_letters[square(j, col)] == QUACKLE_NULL_MARK)
 						break;
 					else
-						word = QUACKLE_ALPHABET_PARAMETERS->clearBlankness(m_letters[j][col]) + word;
+						word = QUACKLE_ALPHABET_PARAMETERS->clearBlankness(m_letters[square(j, col)]) + word;
 				}
 
 				for (int j = row + 1; j < m_height; ++j)
 				{
-					if (m_letters[j][col] == QUACKLE_NULL_MARK)
+					if (m_letters[square(j, col)] == QUACKLE_NULL_MARK)
 						break;
 					else
-						word += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(m_letters[j][col]);
+						word += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(m_letters[square(j, col)]);
 				}
 
 				if (word.length() > 1)
@@ -173,22 +220,22 @@ void Board::updateBritishness()
 				}
 
 				word.clear();
-				word += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(m_letters[row][col]);
+				word += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(m_letters[square(row, col)]);
 
 				for (int j = col - 1; j >= 0; --j)
 				{
-					if (m_letters[row][j] == QUACKLE_NULL_MARK)
+					if (m_letters[square(row, j)] == QUACKLE_NULL_MARK)
 						break;
 					else
-						word = QUACKLE_ALPHABET_PARAMETERS->clearBlankness(m_letters[row][j]) + word;
+						word = QUACKLE_ALPHABET_PARAMETERS->clearBlankness(m_letters[square(row, j)]) + word;
 				}
 
 				for (int j = col + 1; j < m_width; ++j)
 				{
-					if (m_letters[row][j] == QUACKLE_NULL_MARK)
+					if (m_letters[square(row, j)] == QUACKLE_NULL_MARK)
 						break;
 					else
-						word += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(m_letters[row][j]);
+						word += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(m_letters[square(row, j)]);
 				}
 
 				if (word.length() > 1)
@@ -202,7 +249,7 @@ void Board::updateBritishness()
 				}
 			}
 
-			m_isBritish[row][col] = isBritish;
+			m_isBritish[square(row, col)] = isBritish;
 		}
 	}
 }
@@ -229,7 +276,7 @@ MoveList Board::allWordsFormedBy(const Move &move) const
 				int i = 0;
 				for (const auto& it : move.tiles())
 				{
-					if (m_letters[move.startrow][i + move.startcol] == QUACKLE_NULL_MARK)
+					if (m_letters[square(move.startrow, i + move.startcol)] == QUACKLE_NULL_MARK)
 					{
 						word.clear();
 						word += it;
@@ -237,23 +284,23 @@ MoveList Board::allWordsFormedBy(const Move &move) const
 						int startRow = 0;
 						for (int j = move.startrow - 1; j >= 0; --j)
 						{
-							if (m_letters[j][i + move.startcol] == QUACKLE_NULL_MARK)
+							if (m_letters[square(j, i + move.startcol)] == QUACKLE_NULL_MARK)
 							{
 								startRow = j + 1;
 								break;
 							}
 							else
 							{
-								word = m_letters[j][i + move.startcol] + word;
+								word = m_letters[square(j, i + move.startcol)] + word;
 							}
 						}
 
 						for (int j = move.startrow + 1; j < m_height; ++j)
 						{
-							if (m_letters[j][i + move.startcol] == QUACKLE_NULL_MARK)
+							if (m_letters[square(j, i + move.startcol)] == QUACKLE_NULL_MARK)
 								j = m_height;
 							else
-								word += m_letters[j][i + move.startcol];
+								word += m_letters[square(j, i + move.startcol)];
 						}
 
 						if (word.length() > 1)
@@ -269,7 +316,7 @@ MoveList Board::allWordsFormedBy(const Move &move) const
 				int i = 0;
 				for (const auto& it : move.tiles())
 				{
-					if (m_letters[i + move.startrow][move.startcol] == QUACKLE_NULL_MARK)
+					if (m_letters[square(i + move.startrow, move.startcol)] == QUACKLE_NULL_MARK)
 					{
 						word.clear();
 						word += it;
@@ -277,23 +324,23 @@ MoveList Board::allWordsFormedBy(const Move &move) const
 						int startColumn = 0;
 						for (int j = move.startcol - 1; j >= 0; --j)
 						{
-							if (m_letters[i + move.startrow][j] == QUACKLE_NULL_MARK)
+							if (m_letters[square(i + move.startrow, j)] == QUACKLE_NULL_MARK)
 							{
 								startColumn = j + 1;
 								break;
 							}
 							else
 							{
-								word = m_letters[i + move.startrow][j] + word;
+								word = m_letters[square(i + move.startrow, j)] + word;
 							}
 						}
 
 						for (int j = move.startcol + 1; j < m_width; ++j)
 						{
-							if (m_letters[i + move.startrow][j] == QUACKLE_NULL_MARK)
+							if (m_letters[square(i + move.startrow, j)] == QUACKLE_NULL_MARK)
 								j = m_width;
 							else
-								word += m_letters[i + move.startrow][j];
+								word += m_letters[square(i + move.startrow, j)];
 						}
 
 						if (word.length() > 1)
@@ -324,125 +371,44 @@ int Board::score(const Move &move, bool *isBingo) const
 
 	if (move.action == Move::Place)
 	{
+		const AlphabetParameters *alphabet = QUACKLE_ALPHABET_PARAMETERS;
+		const BoardParameters *boardParameters = QUACKLE_BOARD_PARAMETERS;
+		const short *hookScores = m_hookScores[move.horizontal? 0 : 1];
+
 		int total;
 		int laid = 0;
 		int mainscore = 0;
 		int hookscore = 0;
 		int wordmult = 1;
 
-		if (move.horizontal)
-		{
-			int i = 0;
-			const LetterString::const_iterator end(move.tiles().end());
-			for (LetterString::const_iterator it = move.tiles().begin(); it != end; ++it, ++i)
-			{
-				if (m_letters[move.startrow][i + move.startcol] == QUACKLE_NULL_MARK)
-				{
-					if (QUACKLE_ALPHABET_PARAMETERS->isPlainLetter(*it))
-						mainscore += QUACKLE_ALPHABET_PARAMETERS->score(*it) * letterMultiplier(move.startrow, i + move.startcol);
-
-					++laid;
-
-					wordmult *= wordMultiplier(move.startrow, i + move.startcol);
-
-					int thishook = 0;
-					int hooked = 0;
-
-					for (int j = move.startrow - 1; j >= 0; --j)
-					{
-						if (m_letters[j][i + move.startcol] == QUACKLE_NULL_MARK)
-							j = -1;
-						else
-						{
-							++hooked;
-
-							if (!m_isBlank[j][i + move.startcol])
-								thishook += QUACKLE_ALPHABET_PARAMETERS->score(m_letters[j][i + move.startcol]);
-						}
-					}
-
-					for (int j = move.startrow + 1; j < m_height; ++j)
-					{
-						if (m_letters[j][i + move.startcol] == QUACKLE_NULL_MARK)
-							j = m_height;
-						else
-						{
-							++hooked;
-
-							if (!m_isBlank[j][i + move.startcol])
-								thishook += QUACKLE_ALPHABET_PARAMETERS->score(m_letters[j][i + move.startcol]);
-						}
-					}
-
-					if (hooked > 0)
-					{
-						if (QUACKLE_ALPHABET_PARAMETERS->isPlainLetter(*it))
-							thishook += QUACKLE_ALPHABET_PARAMETERS->score(*it) * letterMultiplier(move.startrow, i + move.startcol);
+		int row = move.startrow;
+		int col = move.startcol;
+		int sq = square(row, col);
+		const int step = move.horizontal? 1 : m_width;
 
-						thishook *= wordMultiplier(move.startrow, i + move.startcol);
-						hookscore += thishook;
-					} 
-				}
-				else if (!m_isBlank[move.startrow][i + move.startcol])
-					mainscore += QUACKLE_ALPHABET_PARAMETERS->score(m_letters[move.startrow][i + move.startcol]);
-			}
-		}
-		else
+		const LetterString::const_iterator end(move.tiles().end());
+		for (LetterString::const_iterator it = move.tiles().begin(); it != end; ++it)
 		{
-			int i = 0;
-			const LetterString::const_iterator end(move.tiles().end());
-			for (LetterString::const_iterator it = move.tiles().begin(); it != end; ++it, ++i)
+			if (m_letters[sq] == QUACKLE_NULL_MARK)
 			{
-				if (m_letters[i + move.startrow][move.startcol] == QUACKLE_NULL_MARK)
-				{
-					if (QUACKLE_ALPHABET_PARAMETERS->isPlainLetter(*it))
-						mainscore += QUACKLE_ALPHABET_PARAMETERS->score(*it) * letterMultiplier(i + move.startrow, move.startcol);
-
-					++laid;
+				const int tilescore = alphabet->isPlainLetter(*it)? alphabet->score(*it) * boardParameters->letterMultiplier(row, col) : 0;
+				const int squaremult = boardParameters->wordMultiplier(row, col);
 
-					wordmult *= wordMultiplier(i + move.startrow, move.startcol);
+				mainscore += tilescore;
+				wordmult *= squaremult;
+				++laid;
 
-					int thishook = 0;
-					int hooked = 0;
-
-					for (int j = move.startcol - 1; j >= 0; --j)
-					{
-						if (m_letters[i + move.startrow][j] == QUACKLE_NULL_MARK)
-							j = -1;
-						else
-						{
-							++hooked;
-
-							if (!m_isBlank[i + move.startrow][j])
-								thishook += QUACKLE_ALPHABET_PARAMETERS->score(m_letters[i + move.startrow][j]);
-						}
-					}
-
-					for (int j = move.startcol + 1; j < m_width; ++j)
-					{
-						if (m_letters[i + move.startrow][j] == QUACKLE_NULL_MARK)
-							j = m_width;
-						else
-						{
-							++hooked;
-
-							if (!m_isBlank[i + move.startrow][j])
-								thishook += QUACKLE_ALPHABET_PARAMETERS->score(m_letters[i + move.startrow][j]);
-						}
-					}
-
-					if (hooked > 0)
-					{
-						if (QUACKLE_ALPHABET_PARAMETERS->isPlainLetter(*it))
-							thishook += QUACKLE_ALPHABET_PARAMETERS->score(*it) * letterMultiplier(i + move.startrow, move.startcol);
-
-						thishook *= wordMultiplier(i + move.startrow, move.startcol);
-						hookscore += thishook;
-					}
-				}
-				else if (!m_isBlank[i + move.startrow][move.startcol])
-					mainscore += QUACKLE_ALPHABET_PARAMETERS->score(m_letters[i + move.startrow][move.startcol]);
+				if (hookScores[sq] >= 0)
+					hookscore += (hookScores[sq] + tilescore) * squaremult;
 			}
+			else if (!m_isBlank[sq])
+				mainscore += alphabet->score(m_letters[sq]);
+
+			sq += step;
+			if (move.horizontal)
+				col++;
+			else
+				row++;
 		}
 
 		total = hookscore;
@@ -494,7 +460,7 @@ LetterString Board::prettyTilesOfMove(const Move &move, bool markPlayThruTiles)
 				insidePlayThru = true;
 			}
 
-			ret += m_letters[currentTileRow][currentTileCol];
+			ret += m_letters[square(currentTileRow, currentTileCol)];
 		}
 		else 
 		{
@@ -536,7 +502,7 @@ LetterString Board::sanitizedTilesOfMove(const Move &move) const
 			else
 				currentTileRow += i;
 
-			if (m_letters[currentTileRow][currentTileCol] == QUACKLE_NULL_MARK)
+			if (m_letters[square(currentTileRow, currentTileCol)] == QUACKLE_NULL_MARK)
 				ret += *it;
 			else
 				ret += QUACKLE_PLAYED_THRU_MARK;
@@ -556,10 +522,12 @@ void Board::makeMove(const Move &move)
 		const LetterString::const_iterator end(move.tiles().end());
 		for (LetterString::const_iterator it = move.tiles().begin(); it != end; ++it)
 		{
-			if (m_letters[row][col] == QUACKLE_NULL_MARK)
+			if (m_letters[square(row, col)] == QUACKLE_NULL_MARK)
 			{
-				m_letters[row][col] = *it;
-				m_isBlank[row][col] = QUACKLE_ALPHABET_PARAMETERS->isBlankLetter(*it);
+				m_letters[square(row, col)] = *it;
+				m_isBlank[square(row, col)] = QUACKLE_ALPHABET_PARAMETERS->isBlankLetter(*it);
+				m_occupied[0][row] |= uint64_t(1) << col;
+				m_occupied[1][col] |= uint64_t(1) << row;
 			}
 
 			if (move.horizontal)
@@ -567,6 +535,155 @@ void Board::makeMove(const Move &move)
 			else
 				row++;
 		}
+
+		// Anchors can only change along the line of the move, the lines
+		// on either side of it, and the perpendicular lines through and
+		// just past the laid tiles.
+		const int length = move.tiles().length();
+		const int line = move.horizontal? move.startrow : move.startcol;
+		const int first = move.horizontal? move.startcol : move.startrow;
+		const int lineCount = move.horizontal? m_height : m_width;
+		const int crossCount = move.horizontal? m_width : m_height;
+
+		for (int i = line - 1; i <= line + 1; ++i)
+			if (i >= 0 && i < lineCount)
+				updateAnchors(i, move.horizontal);
+
+		for (int i = first - 1; i <= first + length; ++i)
+			if (i >= 0 && i < crossCount)
+				updateAnchors(i, !move.horizontal);
+
+		// and hook scores only along the line of the move and the
+		// perpendicular lines through its tiles
+		updateHookScores(line, move.horizontal);
+		for (int i = first; i < first + length; ++i)
+			updateHookScores(i, !move.horizontal);
+	}
+}
+
+void Board::updateAnchors(int line, bool horizontal)
+{
+	const int direction = horizontal? 0 : 1;
+	const int length = horizontal? m_width : m_height;
+	const int crossLength = horizontal? m_height : m_width;
+
+	bool filled[QUACKLE_MAXIMUM_BOARD_SIZE];
+	bool hooked[QUACKLE_MAXIMUM_BOARD_SIZE];
+
+	// squares with a tile next to them in the perpendicular direction
+	uint64_t hooks = 0;
+	if (line > 0)
+		hooks |= m_occupied[direction][line - 1];
+	if (line < crossLength - 1)
+		hooks |= m_occupied[direction][line + 1];
+
+	const uint64_t occupied = m_occupied[direction][line];
+	for (int i = 0; i < length; ++i)
+	{
+		filled[i] = (occupied >> i) & 1;
+		hooked[i] = (hooks >> i) & 1;
+	}
+
+	for (int i = 0; i < length; ++i)
+	{
+		const int row = horizontal? line : i;
+		const int col = horizontal? i : line;
+		const uint64_t bit = uint64_t(1) << col;
+
+		// number of hookless empty squares left of square start that
+		// don't themselves touch a tile to their left
+		int openSquares = 0;
+		for (int j = i - 1; j >= 0 && !filled[j] && !hooked[j]; --j)
+		{
+			if (j == 0 || !filled[j - 1])
+				++openSquares;
+		}
+
+		bool dawgAnchor;
+		if (filled[i])
+			dawgAnchor = i == 0 || !filled[i - 1];
+		else
+			dawgAnchor = hooked[i] && (i == 0 || !filled[i - 1]);
+
+		bool gaddagAnchor;
+		if (filled[i])
+			gaddagAnchor = i == length - 1 || !filled[i + 1];
+		else if (!hooked[i])
+			gaddagAnchor = false;
+		else if (i == 0)
+			gaddagAnchor = !filled[i + 1];
+		else
+			gaddagAnchor = !filled[i - 1] && (i == length - 1 || !filled[i + 1]);
+
+		int gaddagLimit = 0;
+		if (gaddagAnchor)
+		{
+			// skip over the filled squares of the word ending here
+			int j = i;
+			while (j >= 0 && filled[j])
+			{
+				++gaddagLimit;
+				--j;
+			}
+
+			for (--j; j >= 0 && !filled[j] && !hooked[j]; --j)
+			{
+				if (j == 0 || !filled[j - 1])
+					++gaddagLimit;
+			}
+		}
+
+		if (dawgAnchor)
+			m_dawgAnchors[direction][row] |= bit;
+		else
+			m_dawgAnchors[direction][row] &= ~bit;
+
+		if (gaddagAnchor)
+			m_gaddagAnchors[direction][row] |= bit;
+		else
+			m_gaddagAnchors[direction][row] &= ~bit;
+
+		m_dawgAnchorLimits[direction][square(row, col)] = dawgAnchor? openSquares : 0;
+		m_gaddagAnchorLimits[direction][square(row, col)] = gaddagLimit;
+	}
+}
+
+void Board::updateHookScores(int line, bool horizontal)
+{
+	// the scores are for plays across this line
+	const int direction = horizontal? 1 : 0;
+	const int length = horizontal? m_width : m_height;
+	const int step = horizontal? 1 : m_width;
+	const int start = horizontal? square(line, 0) : square(0, line);
+	const uint64_t occupied = m_occupied[horizontal? 0 : 1][line];
+
+	// summed tile scores of the run of tiles ending at each square
+	int runScores[QUACKLE_MAXIMUM_BOARD_SIZE];
+	int run = 0;
+	for (int i = 0, sq = start; i < length; ++i, sq += step)
+	{
+		if (m_letters[sq] == QUACKLE_NULL_MARK)
+			run = 0;
+		else if (!m_isBlank[sq])
+			run += QUACKLE_ALPHABET_PARAMETERS->score(m_letters[sq]);
+		runScores[i] = run;
+	}
+
+	run = 0;
+	for (int i = length - 1, sq = start + i * step; i >= 0; --i, sq -= step)
+	{
+		if (m_letters[sq] != QUACKLE_NULL_MARK)
+		{
+			if (!m_isBlank[sq])
+				run += QUACKLE_ALPHABET_PARAMETERS->score(m_letters[sq]);
+			continue;
+		}
+
+		if (occupied & neighbourBits(i))
+			m_hookScores[direction][sq] = (i > 0? runScores[i - 1] : 0) + run;
+		else
+			m_hookScores[direction][sq] = -1;
+		run = 0;
 	}
 }
 
@@ -595,9 +712,9 @@ UVString Board::toString() const
 
 		for (int col = 0; col < m_width; col++)
 		{
-			if (m_letters[row][col] != QUACKLE_NULL_MARK)
+			if (m_letters[square(row, col)] != QUACKLE_NULL_MARK)
 			{
-				ss << QUACKLE_ALPHABET_PARAMETERS->userVisible(m_letters[row][col]);
+				ss << QUACKLE_ALPHABET_PARAMETERS->userVisible(m_letters[square(row, col)]);
 			}
 			else
 			{
@@ -674,15 +791,15 @@ UVString Board::htmlBoard(const int tileSize) const
 				bgcolor = "goldenrod";
 
 			ss << "<td height=" << tdHeight << " width=" << tdWidth << " bgcolor=\"" << bgcolor << "\" " << centerAlign << ">";
-			if (m_letters[row][col] != QUACKLE_NULL_MARK)
+			if (m_letters[square(row, col)] != QUACKLE_NULL_MARK)
 			{
 				const int fontSize = static_cast<int>(tileSize * 5/9);
-				if (QUACKLE_ALPHABET_PARAMETERS->isBlankLetter(m_letters[row][col]))
+				if (QUACKLE_ALPHABET_PARAMETERS->isBlankLetter(m_letters[square(row, col)]))
 				{
 					const int blankFontSize = static_cast<int>(fontSize * 0.8);
 					ss << "<table style=\"border: 1pt; border-style: dashed\"><tr><td width=" << tdWidth * 0.8 << " height=" << tdHeight * 0.8 << " bgcolor=\"" << bgcolor << "\" " << centerAlign << ">";
 					ss << "<span style=\"font-size: " << blankFontSize << "px\">";
-					ss << QUACKLE_ALPHABET_PARAMETERS->userVisible(QUACKLE_ALPHABET_PARAMETERS->clearBlankness(m_letters[row][col]));
+					ss << QUACKLE_ALPHABET_PARAMETERS->userVisible(QUACKLE_ALPHABET_PARAMETERS->clearBlankness(m_letters[square(row, col)]));
 					ss << "</span>";
 					ss << "</td></tr></table>";
 				}
@@ -692,10 +809,10 @@ UVString Board::htmlBoard(const int tileSize) const
 					const int minimumValueFontSize = 7;
 					const int valueFontSize = minimumValueFontSize > idealValueFontSize? minimumValueFontSize : idealValueFontSize;
 					ss << "<span style=\"font-size: " << fontSize << "px\">";
-					ss << QUACKLE_ALPHABET_PARAMETERS->userVisible(m_letters[row][col]);
+					ss << QUACKLE_ALPHABET_PARAMETERS->userVisible(m_letters[square(row, col)]);
 					ss << "</span>";
 					ss << "<span style=\"font-size: " << valueFontSize << "px\">";
-					ss << QUACKLE_ALPHABET_PARAMETERS->score(m_letters[row][col]);
+					ss << QUACKLE_ALPHABET_PARAMETERS->score(m_letters[square(row, col)]);
 					ss << "</span>";
 				}
 			}
@@ -742,24 +859,31 @@ void Board::prepareEmptyBoard()
 	{
 		for (int j = 0; j < m_width; ++j)
 		{
-			m_letters[i][j] = QUACKLE_NULL_MARK;
-			m_isBlank[i][j] = false;
-			m_vcross[i][j].set();
-			m_hcross[i][j].set();
+			m_letters[square(i, j)] = QUACKLE_NULL_MARK;
+			m_isBlank[square(i, j)] = false;
+			m_vcross[square(i, j)] = m_hcross[square(i, j)] = LetterBitset().set().to_ullong();
+			m_hookScores[0][square(i, j)] = m_hookScores[1][square(i, j)] = -1;
 		}
+
+		m_occupied[0][i] = 0;
+		m_gaddagAnchors[0][i] = m_gaddagAnchors[1][i] = 0;
+		m_dawgAnchors[0][i] = m_dawgAnchors[1][i] = 0;
 	}
+
+	for (int j = 0; j < m_width; ++j)
+		m_occupied[1][j] = 0;
 }
 
 Board::TileInformation Board::tileInformation(int row, int col) const
 {
 	TileInformation ret;
 
-	if (m_letters[row][col] != QUACKLE_NULL_MARK)
+	if (m_letters[square(row, col)] != QUACKLE_NULL_MARK)
 	{
 		ret.tileType = LetterTile;
-		ret.isBlank = m_isBlank[row][col];
-		ret.letter = QUACKLE_ALPHABET_PARAMETERS->clearBlankness(m_letters[row][col]);
-		ret.isBritish = m_isBritish[row][col];
+		ret.isBlank = m_isBlank[square(row, col)];
+		ret.letter = QUACKLE_ALPHABET_PARAMETERS->clearBlankness(m_letters[square(row, col)]);
+		ret.isBritish = m_isBritish[square(row, col)];
 	}
 	else
 	{
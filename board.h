@@ -21,6 +21,7 @@
 
 #include <vector>
 #include <bitset>
+#include <cstdint>
 
 #include "alphabetparameters.h"
 #include "bag.h"
@@ -47,6 +48,10 @@ public:
     // QUACKLE_MINIMUM_BOARD_SIZE and QUACKLE_MAXIMUM_BOARD_SIZE.
     Board(int width, int height);
 
+    // copies only the squares of the board's own size
+    Board(const Board &board);
+    Board &operator=(const Board &board);
+
     // use this to start out your board for use
 	void prepareEmptyBoard();
 
@@ -123,25 +128,75 @@ public:
 	bool isBlank(int row, int col) const;
 	bool isBritish(int row, int col) const;
 
-	const LetterBitset &vcross(int row, int col) const;
+	LetterBitset vcross(int row, int col) const;
 	void setVCross(int row, int col, const LetterBitset &vcross);
 
-	const LetterBitset &hcross(int row, int col) const;
+	LetterBitset hcross(int row, int col) const;
 	void setHCross(int row, int col, const LetterBitset &hcross);
 
+	// Bit i is set if square i of the given row (horizontal) or
+	// column is filled.
+	uint64_t occupied(int line, bool horizontal) const;
+
+	// For an empty square, the summed scores of the tiles of the word
+	// a play in the given direction would form across it, or -1 if it
+	// would form none. Kept up to date by makeMove.
+	int hookScore(int row, int col, bool horizontal) const;
+
+	// Anchor squares for the move generators, kept up to date by
+	// prepareEmptyBoard and makeMove. Bit col of the returned mask is
+	// set if (row, col) is an anchor for plays in the given direction.
+	// Gaddag anchors are the squares gordongenerate grows plays from
+	// (the last tile of each word and empty squares with perpendicular
+	// hooks); dawg anchors are the leftmost (topmost) such squares used
+	// by generate.
+	uint64_t gaddagAnchors(int row, bool horizontal) const;
+	uint64_t dawgAnchors(int row, bool horizontal) const;
+
+	// how many squares left of (or above) the anchor plays may start
+	int gaddagAnchorLimit(int row, int col, bool horizontal) const;
+	int dawgAnchorLimit(int row, int col, bool horizontal) const;
+
 protected:
 	int m_width;
 	int m_height;
 	bool m_empty;
 
-	Letter m_letters[QUACKLE_MAXIMUM_BOARD_SIZE][QUACKLE_MAXIMUM_BOARD_SIZE];
-	bool m_isBlank[QUACKLE_MAXIMUM_BOARD_SIZE][QUACKLE_MAXIMUM_BOARD_SIZE];
-	bool m_isBritish[QUACKLE_MAXIMUM_BOARD_SIZE][QUACKLE_MAXIMUM_BOARD_SIZE];
+	// Squares are stored row by row at square(row, col), so only the
+	// first m_width * m_height entries of each array are in use and
+	// copying a board copies just those.
+	Letter m_letters[QUACKLE_MAXIMUM_BOARD_SIZE * QUACKLE_MAXIMUM_BOARD_SIZE];
+	bool m_isBlank[QUACKLE_MAXIMUM_BOARD_SIZE * QUACKLE_MAXIMUM_BOARD_SIZE];
+	bool m_isBritish[QUACKLE_MAXIMUM_BOARD_SIZE * QUACKLE_MAXIMUM_BOARD_SIZE];
+
+	// cross-sets in LetterBitset::to_ullong() form
+	uint64_t m_vcross[QUACKLE_MAXIMUM_BOARD_SIZE * QUACKLE_MAXIMUM_BOARD_SIZE];
+	uint64_t m_hcross[QUACKLE_MAXIMUM_BOARD_SIZE * QUACKLE_MAXIMUM_BOARD_SIZE];
+
+	// filled squares by row ([0][row]) and by column ([1][col])
+	uint64_t m_occupied[2][QUACKLE_MAXIMUM_BOARD_SIZE];
 
-	LetterBitset m_vcross[QUACKLE_MAXIMUM_BOARD_SIZE][QUACKLE_MAXIMUM_BOARD_SIZE];
-	LetterBitset m_hcross[QUACKLE_MAXIMUM_BOARD_SIZE][QUACKLE_MAXIMUM_BOARD_SIZE];
+	uint64_t m_gaddagAnchors[2][QUACKLE_MAXIMUM_BOARD_SIZE];
+	uint64_t m_dawgAnchors[2][QUACKLE_MAXIMUM_BOARD_SIZE];
+	unsigned char m_gaddagAnchorLimits[2][QUACKLE_MAXIMUM_BOARD_SIZE * QUACKLE_MAXIMUM_BOARD_SIZE];
+	unsigned char m_dawgAnchorLimits[2][QUACKLE_MAXIMUM_BOARD_SIZE * QUACKLE_MAXIMUM_BOARD_SIZE];
 
+	// For each empty square, the summed tile scores of the word a tile
+	// laid there would form across a horizontal ([0]) or vertical ([1])
+	// play, or -1 if it would form none; this lets score() make one pass.
+	short m_hookScores[2][QUACKLE_MAXIMUM_BOARD_SIZE * QUACKLE_MAXIMUM_BOARD_SIZE];
+
+	int square(int row, int col) const;
 	inline bool isNonempty(int row, int column) const;
+
+	void copyFrom(const Board &board);
+
+	// recompute anchors and limits of one row (horizontal) or column
+	void updateAnchors(int line, bool horizontal);
+
+	// recompute m_hookScores for the empty squares of one row
+	// (horizontal) or column, from the tiles along it
+	void updateHookScores(int line, bool horizontal);
 };
 
 inline bool Board::isEmpty() const
@@ -149,44 +204,79 @@ inline bool Board::isEmpty() const
 	return m_empty;
 }
 
+inline int Board::square(int row, int col) const
+{
+	return row * m_width + col;
+}
+
 inline Letter Board::letter(int row, int col) const
 {
-	return m_letters[row][col];
+	return m_letters[square(row, col)];
 }
 
 inline bool Board::isBlank(int row, int col) const
 {
-	return m_isBlank[row][col];
+	return m_isBlank[square(row, col)];
 }
 
 inline bool Board::isBritish(int row, int col) const
 {
-	return m_isBritish[row][col];
+	return m_isBritish[square(row, col)];
 }
 
-inline const LetterBitset &Board::vcross(int row, int col) const
+inline LetterBitset Board::vcross(int row, int col) const
 {
-	return m_vcross[row][col];
+	return LetterBitset(m_vcross[square(row, col)]);
 }
 
 inline void Board::setVCross(int row, int col, const LetterBitset &vcross)
 {
-	m_vcross[row][col] = vcross;
+	m_vcross[square(row, col)] = vcross.to_ullong();
 }
 
-inline const LetterBitset &Board::hcross(int row, int col) const
+inline LetterBitset Board::hcross(int row, int col) const
 {
-	return m_hcross[row][col];
+	return LetterBitset(m_hcross[square(row, col)]);
 }
 
 inline void Board::setHCross(int row, int col, const LetterBitset &hcross)
 {
-	m_hcross[row][col] = hcross;
+	m_hcross[square(row, col)] = hcross.to_ullong();
+}
+
+inline uint64_t Board::occupied(int line, bool horizontal) const
+{
+	return m_occupied[horizontal? 0 : 1][line];
+}
+
+inline int Board::hookScore(int row, int col, bool horizontal) const
+{
+	return m_hookScores[horizontal? 0 : 1][square(row, col)];
+}
+
+inline uint64_t Board::gaddagAnchors(int row, bool horizontal) const
+{
+	return m_gaddagAnchors[horizontal? 0 : 1][row];
+}
+
+inline uint64_t Board::dawgAnchors(int row, bool horizontal) const
+{
+	return m_dawgAnchors[horizontal? 0 : 1][row];
+}
+
+inline int Board::gaddagAnchorLimit(int row, int col, bool horizontal) const
+{
+	return m_gaddagAnchorLimits[horizontal? 0 : 1][square(row, col)];
+}
+
+inline int Board::dawgAnchorLimit(int row, int col, bool horizontal) const
+{
+	return m_dawgAnchorLimits[horizontal? 0 : 1][square(row, col)];
 }
 
 inline bool Board::isNonempty(int row, int column) const
 {
-	return m_letters[row][column] != QUACKLE_NULL_MARK;
+	return m_letters[square(row, column)] != QUACKLE_NULL_MARK;
 }
 
 }
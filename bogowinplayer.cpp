@@ -46,6 +46,11 @@ SmartBogowin::SmartBogowin()
 	m_additionalInitialCandidates = 13;
 
     m_inferring = false;
+	m_racing = false;
+
+	// candidates are simmed one after another, so they are only
+	// compared fairly if they draw the same tiles
+	m_simulator.setCommonRandomNumbers(true);
 }
 
 SmartBogowin::~SmartBogowin()
@@ -159,6 +164,30 @@ MoveList SmartBogowin::moves(int nmoves)
 
 	signalFractionDone(0);
 
+	if (m_racing)
+	{
+		m_simulator.setIncludedMoves(staticMoves);
+		m_simulator.race(plies, maxIterations(), m_parameters.secondsPerTurn, /* by win */ true);
+
+		// The moves the race dropped early have fewer, noisier
+		// iterations behind their wins than those it kept, so they
+		// rank after all of those.
+		MoveList dropped;
+		for (const auto &move : m_simulator.moves(/* prune */ false, /* sort by win */ true))
+		{
+			if (!staticMoves.contains(move))
+				continue;
+
+			if (m_simulator.simmedMoveForMove(move).includeInSimulation())
+				simmedMoves.push_back(move);
+			else
+				dropped.push_back(move);
+		}
+
+		simmedMoves.insert(simmedMoves.end(), dropped.begin(), dropped.end());
+		return bestMoves(simmedMoves, nmoves, /* sort by win */ false);
+	}
+
 	m_simulator.setIncludedMoves(firstMove);
 	m_simulator.simulate(plies, minIterations());
 	
@@ -185,7 +214,17 @@ MoveList SmartBogowin::moves(int nmoves)
 		double movebp = bogopoints(move);
 		//UVcout << "we just simmed " << move << "; bogopoints: " << movebp << endl;
 	
-		if (movebp + 1.96 * 35.0 / sqrt((double)minIterations()) > bestbp)
+		bool promising;
+		if (m_simulator.commonRandomNumbers())
+		{
+			// how far behind best it is on the same tiles
+			const AveragedValue behind = m_simulator.simmedMoveForMove(move).pairedDifference(m_simulator.simmedMoveForMove(best), /* by win */ true);
+			promising = !behind.hasValues() || behind.averagedValue() + 1.96 * behind.standardDeviation() / sqrt((double)behind.incorporatedValues()) > 0;
+		}
+		else
+			promising = movebp + 1.96 * 35.0 / sqrt((double)minIterations()) > bestbp;
+
+		if (promising)
 		{
 			m_simulator.simulate(plies, maxIterations() - minIterations());
 			Move move2 = *m_simulator.moves(true, true).begin();
@@ -214,7 +253,14 @@ MoveList SmartBogowin::moves(int nmoves)
 	//UVcout << "We had extra time! whoopee!" << endl;
 
 	sort_and_return:
-	MoveList::sort(simmedMoves, MoveList::Win);
+	return bestMoves(simmedMoves, nmoves);
+}
+
+MoveList SmartBogowin::bestMoves(MoveList &simmedMoves, int nmoves, bool sortByWin) const
+{
+	if (sortByWin)
+		MoveList::sort(simmedMoves, MoveList::Win);
+
 	MoveList ret;
 	MoveList::const_iterator simmedEnd = simmedMoves.end();
 	int i = 0;
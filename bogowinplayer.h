@@ -39,10 +39,20 @@ public:
 	virtual bool isUserVisible() const;
 	virtual double bogopoints(Move &move);
 
+	// If racing, all candidates are simmed together for the whole
+	// turn, dropping those that are clearly losing as it goes,
+	// rather than one after another.
+	void setRacing(bool racing);
+	bool racing() const;
+
 protected:
 	int minIterations() const;
 	int maxIterations() const;
 
+	// the best nmoves of simmedMoves by win, and any considered moves;
+	// unless sortByWin, simmedMoves are taken to be ranked already
+	MoveList bestMoves(MoveList &simmedMoves, int nmoves, bool sortByWin = true) const;
+
 	Endgame m_endgame;
 
 	int m_additionalInitialCandidates;
@@ -52,6 +62,7 @@ protected:
 	int m_nestedMaxIterationsPerSecond;
 
     bool m_inferring;
+	bool m_racing;
 };
 
 inline bool SmartBogowin::isSlow() const
@@ -64,6 +75,16 @@ inline bool SmartBogowin::isUserVisible() const
 	return true;
 }
 
+inline void SmartBogowin::setRacing(bool racing)
+{
+	m_racing = racing;
+}
+
+inline bool SmartBogowin::racing() const
+{
+	return m_racing;
+}
+
 inline int SmartBogowin::minIterations() const
 {
 	if (currentPosition().nestedness() > 0)
@@ -16,17 +16,154 @@
  *  along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cstring>
+
 #include "board.h"
 #include "datamanager.h"
 #include "game.h"
+#include "movesink.h"
 #include "strategyparameters.h"
 #include "catchall.h"
 
 using namespace Quackle;
 
+// by how many tiles are left in the bag, plus seven
+static const double timingHeuristics[13] =
+{
+	0.0, -8.0, 0.0, -0.5, -2.0, -3.5, -2.0,
+	2.0, 10.0, 7.0,  4.0, -1.0, -2.0
+};
+
+// the rack tile a tile of a move comes from, as String::usedTiles has
+// it, or QUACKLE_NULL_MARK if it's played through
+static Letter usedTile(Letter tile)
+{
+	if (tile == QUACKLE_BLANK_MARK || QUACKLE_ALPHABET_PARAMETERS->isBlankLetter(tile))
+		return QUACKLE_BLANK_MARK;
+	if (QUACKLE_ALPHABET_PARAMETERS->isPlainLetter(tile))
+		return tile;
+	return QUACKLE_NULL_MARK;
+}
+
+// move.usedTiles().length()
+static int usedTileCount(const PackedMove &move)
+{
+	if (move.action == Move::BlindExchange)
+		return 0;
+
+	int ret = 0;
+	for (int i = 0; i < move.length; ++i)
+		if (usedTile(move.tiles[i]) != QUACKLE_NULL_MARK)
+			++ret;
+	return ret;
+}
+
+// what a placement of tiles at start on an empty board is worth
+static double placementAdjustment(int start, const Letter *tiles, int length)
+{
+	int consbits = 0;
+	for (int i = length - 1; i >= 0; i--)
+	{
+		consbits <<= 1;
+		if (QUACKLE_ALPHABET_PARAMETERS->isVowel(QUACKLE_ALPHABET_PARAMETERS->clearBlankness(tiles[i])))
+			consbits |= 1;
+	}
+
+	return QUACKLE_STRATEGY_PARAMETERS->vcPlace(start, length, consbits);
+}
+
+static double opponentDeadwood(const GamePosition &position)
+{
+	double deadwood = 0;
+	for (PlayerList::const_iterator it = position.players().begin(); 
+	     it != position.players().end(); ++it)
+	{
+		if (!(*it == position.currentPlayer()))
+		{
+			deadwood += it->rack().score();
+		}
+	}
+
+	return deadwood;
+}
+
 double CatchallEvaluator::equity(const GamePosition &position, const Move &move) const
 {
 	//UVcout << "catchall being used on " << move.tiles() << endl;
+	if (!position.board().isEmpty() && position.bag().size() == 0)
+		return endgameResult(position, move) + move.score;
+
+	return ScorePlusLeaveEvaluator::equity(position, move) + adjustment(position, move);
+}
+
+double CatchallEvaluator::equity(const GamePosition &position, const Move &move, double valueOfLeave) const
+{
+	if (!position.board().isEmpty() && position.bag().size() == 0)
+		return endgameResult(position, move) + move.score;
+
+	return ScorePlusLeaveEvaluator::equity(position, move, valueOfLeave) + adjustment(position, move);
+}
+
+void CatchallEvaluator::equity(const GamePosition &position, PackedMove *moves, const double *valuesOfLeaves, size_t count) const
+{
+	if (position.board().isEmpty())
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			const PackedMove &move = moves[i];
+			const double adjustment = move.action == Move::Place? placementAdjustment(std::min(move.startrow, move.startcol), move.tiles, move.length) : 3.5;
+			moves[i].equity = valuesOfLeaves[i] + move.score + adjustment;
+		}
+	}
+
+	else if (position.bag().size() > 0)
+	{
+		const int bagPlusSeven = position.bag().size() + 7;
+		for (size_t i = 0; i < count; ++i)
+		{
+			const int leftInBagPlusSeven = bagPlusSeven - usedTileCount(moves[i]);
+			const double timingHeuristic = leftInBagPlusSeven < 13? timingHeuristics[leftInBagPlusSeven] : 0.0;
+			moves[i].equity = valuesOfLeaves[i] + moves[i].score + timingHeuristic;
+		}
+	}
+
+	else
+	{
+		// as endgameResult, with the rack - move worked out on counts
+		const LetterString &rack = position.currentPlayer().rack().tiles();
+		char rackCounts[QUACKLE_FIRST_LETTER + QUACKLE_MAXIMUM_ALPHABET_SIZE];
+		String::counts(rack, rackCounts);
+		const int rackScore = position.currentPlayer().rack().score();
+		const double deadwood = opponentDeadwood(position);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const PackedMove &move = moves[i];
+			char left[QUACKLE_FIRST_LETTER + QUACKLE_MAXIMUM_ALPHABET_SIZE];
+			memcpy(left, rackCounts, sizeof(left));
+			int leaveScore = rackScore;
+			int leaveLength = rack.length();
+
+			for (int j = 0; move.action != Move::BlindExchange && j < move.length; ++j)
+			{
+				const Letter used = usedTile(move.tiles[j]);
+				if (used != QUACKLE_NULL_MARK && left[used] > 0)
+				{
+					--left[used];
+					leaveScore -= QUACKLE_ALPHABET_PARAMETERS->score(used);
+					--leaveLength;
+				}
+			}
+
+			const double result = leaveLength == 0? deadwood * 2 : -8.00 - 2.61 * leaveScore;
+			moves[i].equity = result + move.score;
+		}
+	}
+}
+
+double CatchallEvaluator::adjustment(const GamePosition &position, const Move &move) const
+{
 	if (position.board().isEmpty())
 	{
 		double adjustment = 0;
@@ -38,42 +175,19 @@ double CatchallEvaluator::equity(const GamePosition &position, const Move &move)
 				start = move.startrow;
 		
 			LetterString wordTiles = move.tiles();
-		
-			int length = wordTiles.length();
-	
-			int consbits = 0;
-			for (signed int i = wordTiles.length() - 1; i >= 0; i--)
-			{
-				consbits <<= 1;
-                if (QUACKLE_ALPHABET_PARAMETERS->isVowel(QUACKLE_ALPHABET_PARAMETERS->clearBlankness(wordTiles[i])))
-					consbits |= 1;
-			}
-
-			adjustment = QUACKLE_STRATEGY_PARAMETERS->vcPlace(start, length, consbits);
+			adjustment = placementAdjustment(start, reinterpret_cast<const Letter *>(wordTiles.constData()), wordTiles.length());
 		}
 		else
 			adjustment = 3.5;
 
 		// UVcout << "placement adjustment for " << move << " is " << adjustment << endl;
-		return ScorePlusLeaveEvaluator::equity(position, move) + adjustment;
+		return adjustment;
 	}
 	
-	else if (position.bag().size() > 0)
-	{
-		int leftInBagPlusSeven = position.bag().size() - move.usedTiles().length() + 7;
-		double heuristicArray[13] =
-		{
-			0.0, -8.0, 0.0, -0.5, -2.0, -3.5, -2.0,
-			2.0, 10.0, 7.0,  4.0, -1.0, -2.0
-		};
-		double timingHeuristic = 0.0;
-		if (leftInBagPlusSeven < 13) timingHeuristic = heuristicArray[leftInBagPlusSeven];
-		return ScorePlusLeaveEvaluator::equity(position, move) + timingHeuristic;
-	}
-	else
-	{
-		return endgameResult(position, move) + move.score;
-	}
+	int leftInBagPlusSeven = position.bag().size() - move.usedTiles().length() + 7;
+	double timingHeuristic = 0.0;
+	if (leftInBagPlusSeven < 13) timingHeuristic = timingHeuristics[leftInBagPlusSeven];
+	return timingHeuristic;
 }
 
 double CatchallEvaluator::endgameResult(const GamePosition &position, const Move &move) const
@@ -81,20 +195,7 @@ double CatchallEvaluator::endgameResult(const GamePosition &position, const Move
 	Rack leave = position.currentPlayer().rack() - move;
 
 	if (leave.empty())
-	{
-		double deadwood = 0;
-		for (PlayerList::const_iterator it = position.players().begin(); 
-		     it != position.players().end(); ++it)
-		{
-			if (!(*it == position.currentPlayer()))
-			{
-				deadwood += it->rack().score();
-			}
-		}
-
-		return deadwood * 2;
-	}
+		return opponentDeadwood(position) * 2;
 
     return -8.00 - 2.61 * leave.score();
 }
-
@@ -30,8 +30,20 @@ public:
 	// Evaluator that returns score+leave equity for non-bag-empty positions,
 	// otherwise returns approximate endgame equity
 	virtual double equity(const GamePosition &position, const Move &move) const;
+	virtual double equity(const GamePosition &position, const Move &move, double valueOfLeave) const;
+
+	// The board, bag, rack and opponents' racks are looked at once for
+	// all the moves. This takes sharedConsideration to be
+	// ScorePlusLeaveEvaluator's, so subclasses that change it should
+	// override this too.
+	virtual void equity(const GamePosition &position, PackedMove *moves, const double *valuesOfLeaves, size_t count) const;
 	
 	double endgameResult(const GamePosition &position, const Move &move) const;
+
+protected:
+	// what's added to score+leave: a placement adjustment on an empty
+	// board, otherwise a timing heuristic by tiles left in the bag
+	double adjustment(const GamePosition &position, const Move &move) const;
 };
 
 }
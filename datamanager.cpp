@@ -37,9 +37,22 @@ using namespace std;
 
 DataManager *DataManager::m_self = 0;
 
+// The stream the calling thread draws from, and the seeding it was
+// started from. Seedings are numbered from one across data managers.
+struct ThreadRandomStream {
+  unsigned long seeding = 0;
+  bool numbered = false;
+  unsigned int number = 0;
+  RandomStream stream;
+};
+
+static thread_local ThreadRandomStream threadRandomStream;
+static std::atomic<unsigned long> seedings{0};
+
 DataManager::DataManager()
     : m_evaluator(0), m_parameters(0), m_alphabetParameters(0),
-      m_boardParameters(0), m_lexiconParameters(0), m_strategyParameters(0) {
+      m_boardParameters(0), m_lexiconParameters(0), m_strategyParameters(0),
+      m_seeding(0) {
   m_self = this;
   setAppDataDirectory(".");
   setUserDataDirectory(".");
@@ -192,16 +205,92 @@ string DataManager::makeDataFilename(const string &subDirectory,
 }
 
 void DataManager::seedRandomNumbers(unsigned int seed) {
-  lock_guard<mutex> lock(m_RngMutex);
-  m_mersenneTwisterRng.seed(seed);
+  seed_seq seedSequence{seed};
+  seedRandomNumbers(seedSequence);
 }
 
 void DataManager::seedRandomNumbers(seed_seq &seed) {
   lock_guard<mutex> lock(m_RngMutex);
-  m_mersenneTwisterRng.seed(seed);
+  m_masterStream.seed(seed);
+  m_unnumberedStream = m_masterStream;
+  m_unnumberedStream.longJump();
+
+  if (!threadRandomStream.numbered) {
+    threadRandomStream.numbered = true;
+    threadRandomStream.number = 0;
+  }
+
+  // every thread starts its stream over on its next draw
+  m_seeding = ++seedings;
 }
 
-int DataManager::randomInteger(int low, int high) {
+void DataManager::setRandomStream(unsigned int stream) {
+  threadRandomStream.numbered = true;
+  threadRandomStream.number = stream;
+  threadRandomStream.seeding = 0;
+}
+
+RandomStream &DataManager::threadStream() {
+  ThreadRandomStream &local = threadRandomStream;
+  if (local.seeding == m_seeding.load(memory_order_acquire))
+    return local.stream;
+
   lock_guard<mutex> lock(m_RngMutex);
-  return uniform_int_distribution<>(low, high)(m_mersenneTwisterRng);
+  if (local.numbered) {
+    local.stream = m_masterStream;
+    for (unsigned int i = 0; i < local.number; ++i)
+      local.stream.jump();
+  } else {
+    local.stream = m_unnumberedStream;
+    m_unnumberedStream.jump();
+  }
+
+  local.seeding = m_seeding;
+  return local.stream;
+}
+
+int DataManager::randomInteger(int low, int high) {
+  return uniform_int_distribution<>(low, high)(threadStream());
+}
+
+////////////
+
+void RandomStream::seed(seed_seq &seed) {
+  std::uint32_t words[8];
+  seed.generate(words, words + 8);
+  for (int i = 0; i < 4; ++i)
+    m_state[i] = (std::uint64_t(words[2 * i]) << 32) | words[2 * i + 1];
+
+  // the one state the generator can't leave
+  if (!(m_state[0] | m_state[1] | m_state[2] | m_state[3]))
+    m_state[0] = 1;
+}
+
+void RandomStream::jump() {
+  static const std::uint64_t polynomial[4] = {
+      0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa,
+      0x39abdc4529b1661c};
+  jump(polynomial);
+}
+
+void RandomStream::longJump() {
+  static const std::uint64_t polynomial[4] = {
+      0x76e15d3efefdcbbf, 0xc5004e441c522fb3, 0x77710069854ee241,
+      0x39109bb02acbe635};
+  jump(polynomial);
+}
+
+void RandomStream::jump(const std::uint64_t (&polynomial)[4]) {
+  std::uint64_t state[4] = {0, 0, 0, 0};
+  for (int i = 0; i < 4; ++i) {
+    for (int bit = 0; bit < 64; ++bit) {
+      if (polynomial[i] & (std::uint64_t(1) << bit))
+        for (int j = 0; j < 4; ++j)
+          state[j] ^= m_state[j];
+      (*this)();
+    }
+  }
+
+  for (int j = 0; j < 4; ++j)
+    m_state[j] = state[j];
 }
@@ -20,6 +20,8 @@
 #define QUACKLE_DATAMANAGER_H
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <mutex>
 #include <random>
 #include <string>
@@ -44,6 +46,49 @@ namespace Quackle
 // It provides access to lexica (todo), random numbers,
 // and all parameters for a game
 
+// The xoshiro256** generator of Blackman and Vigna. Streams started a
+// jump apart don't overlap for 2^128 draws.
+class RandomStream
+{
+public:
+	typedef std::uint64_t result_type;
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return ~result_type(0); }
+
+	void seed(std::seed_seq &seed);
+	result_type operator()();
+
+	// skip 2^128 draws
+	void jump();
+
+	// skip 2^192 draws
+	void longJump();
+
+private:
+	static std::uint64_t rotl(std::uint64_t x, int k);
+	void jump(const std::uint64_t (&polynomial)[4]);
+
+	std::uint64_t m_state[4];
+};
+
+inline std::uint64_t RandomStream::rotl(std::uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+inline RandomStream::result_type RandomStream::operator()()
+{
+	const std::uint64_t result = rotl(m_state[1] * 5, 7) * 9;
+	const std::uint64_t t = m_state[1] << 17;
+	m_state[2] ^= m_state[0];
+	m_state[3] ^= m_state[1];
+	m_state[1] ^= m_state[2];
+	m_state[0] ^= m_state[3];
+	m_state[2] ^= t;
+	m_state[3] = rotl(m_state[3], 45);
+	return result;
+}
+
 class AlphabetParameters;
 class BoardParameters;
 class Evaluator;
@@ -122,13 +167,26 @@ public:
 	void setUserDataDirectory(string directory) { m_userDataDirectory = directory; }
 	string userDataDirectory() { return m_userDataDirectory; }
 
+	// Every thread draws random numbers from a stream of its own, so
+	// threads don't wait on each other to draw. The streams are jumps
+	// ahead of the one seeded here; stream 0 is the seeding thread's
+	// unless it chose another. Threads that don't choose one with
+	// setRandomStream get streams apart from the numbered ones, in the
+	// order they first draw after seeding. Seed before other threads
+	// start drawing.
 	void seedRandomNumbers(unsigned int seed);
 	void seedRandomNumbers(std::seed_seq& seed);
+
+	// Draw the calling thread's random numbers from the start of
+	// stream number stream of the seed, now and after reseeding. Runs
+	// with the same seed are the same if each thread draws the same
+	// numbers from a stream of the same number.
+	void setRandomStream(unsigned int stream);
+
 	int randomInteger(int low, int high);
 	template <typename T> void shuffle(T& collection)
 	{
-		std::lock_guard<std::mutex> lock(m_RngMutex);
-		std::shuffle(collection.begin(), collection.end(), m_mersenneTwisterRng);
+		std::shuffle(collection.begin(), collection.end(), threadStream());
 	}
 
 private:
@@ -136,6 +194,9 @@ private:
 
 	bool fileExists(const string &filename);
 
+	// the calling thread's stream, started on the current seed
+	RandomStream &threadStream();
+
 	string m_appDataDirectory;
 
 	string m_userDataDirectory;
@@ -152,7 +213,13 @@ private:
 
 	PlayerList m_computerPlayers;
 
-	std::mt19937_64 m_mersenneTwisterRng;
+	// what the thread streams jump ahead from
+	RandomStream m_masterStream;
+	// where the next thread without a numbered stream starts
+	RandomStream m_unnumberedStream;
+	// identifies the seeding the thread streams must start from
+	std::atomic<unsigned long> m_seeding;
+	// guards the two streams above
 	std::mutex m_RngMutex;
 };
 
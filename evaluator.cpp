@@ -20,6 +20,7 @@
 #include "datamanager.h"
 #include "game.h"
 #include "evaluator.h"
+#include "movesink.h"
 #include "strategyparameters.h"
 #include "catchall.h"
 
@@ -31,6 +32,18 @@ double Evaluator::equity(const GamePosition &position, const Move &move) const
 	return move.effectiveScore();
 }
 
+double Evaluator::equity(const GamePosition &position, const Move &move, double valueOfLeave) const
+{
+	(void) valueOfLeave;
+	return equity(position, move);
+}
+
+void Evaluator::equity(const GamePosition &position, PackedMove *moves, const double *valuesOfLeaves, size_t count) const
+{
+	for (size_t i = 0; i < count; ++i)
+		moves[i].equity = equity(position, moves[i].toMove(), valuesOfLeaves[i]);
+}
+
 double Evaluator::playerConsideration(const GamePosition &position, const Move &move) const
 {
 	(void) position;
@@ -58,6 +71,11 @@ double ScorePlusLeaveEvaluator::equity(const GamePosition &position, const Move
 	return playerConsideration(position, move) + sharedConsideration(position, move) + move.effectiveScore();
 }
 
+double ScorePlusLeaveEvaluator::equity(const GamePosition &position, const Move &move, double valueOfLeave) const
+{
+	return valueOfLeave + sharedConsideration(position, move) + move.effectiveScore();
+}
+
 double ScorePlusLeaveEvaluator::playerConsideration(const GamePosition &position, const Move &move) const
 {
 	return leaveValue((position.currentPlayer().rack() - move).tiles());
@@ -74,8 +92,12 @@ double ScorePlusLeaveEvaluator::leaveValue(const LetterString &leave) const
 {
 	LetterString alphabetized = String::alphabetize(leave);
 	
-	if (QUACKLE_STRATEGY_PARAMETERS->hasSuperleaves() && QUACKLE_STRATEGY_PARAMETERS->superleave(alphabetized))
-		return QUACKLE_STRATEGY_PARAMETERS->superleave(alphabetized);
+	if (QUACKLE_STRATEGY_PARAMETERS->hasSuperleaves())
+	{
+		const double superleave = QUACKLE_STRATEGY_PARAMETERS->superleave(alphabetized);
+		if (superleave)
+			return superleave;
+	}
 
 	double value = 0;
 
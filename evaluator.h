@@ -26,6 +26,7 @@ namespace Quackle
 
 class GamePosition;
 class Move;
+class PackedMove;
 
 class Evaluator
 {
@@ -39,6 +40,17 @@ public:
 	// suitable for equity field of move. Rack must be alphabetized.
 	virtual double equity(const GamePosition &position, const Move &move) const;
 
+	// As equity, for a move whose leave is already known to be worth
+	// valueOfLeave, as leaveValue would have it, so the leave needn't
+	// be worked out again. The default ignores valueOfLeave.
+	virtual double equity(const GamePosition &position, const Move &move, double valueOfLeave) const;
+
+	// Set the equity of each of the count plays at moves, as the
+	// equity above would for the ith made into a Move with leave value
+	// valuesOfLeaves[i]. The default does just that; evaluators can
+	// work out what depends only on the position once for all of them.
+	virtual void equity(const GamePosition &position, PackedMove *moves, const double *valuesOfLeaves, size_t count) const;
+
 	virtual double playerConsideration(const GamePosition &position, const Move &move) const;
 	virtual double sharedConsideration(const GamePosition &position, const Move &move) const;
 
@@ -53,6 +65,11 @@ public:
 	// Evaluator that always returns a score+leave equity
 	virtual double equity(const GamePosition &position, const Move &move) const;
 
+	// valueOfLeave stands in for playerConsideration, so subclasses
+	// that change that should override this too
+	virtual double equity(const GamePosition &position, const Move &move, double valueOfLeave) const;
+	using Evaluator::equity;
+
 	virtual double playerConsideration(const GamePosition &position, const Move &move) const;
 	virtual double sharedConsideration(const GamePosition &position, const Move &move) const;
 
@@ -19,6 +19,12 @@
 #ifndef QUACKLE_GADDAG_H
 #define QUACKLE_GADDAG_H
 
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 #include "alphabetparameters.h"
 
 #define QUACKLE_GADDAG_SEPARATOR QUACKLE_NULL_MARK
@@ -102,6 +108,115 @@ GaddagNode::child(Letter l) const
 	return 0;
 }
 
+// A gaddag node laid out for lookup rather than for disk: besides the
+// GaddagNode fields it carries a mask of its children's letters, so
+// finding a child is a popcount instead of a walk over the siblings.
+// Nodes sit at the same indices as in the on-disk gaddag, so children
+// are still packed in letter order with the separator last; the
+// separator takes the top bit of the mask to keep that order.
+class IndexedGaddagNode
+{
+public:
+	Letter letter() const;
+	bool isTerminal() const;
+	const IndexedGaddagNode *firstChild() const;
+	const IndexedGaddagNode *nextSibling() const;
+	const IndexedGaddagNode *child(Letter l) const;
+
+	// the letterBit()s of every child of this node
+	uint64_t childLetters() const;
+
+	// the child for one bit of childLetters()
+	const IndexedGaddagNode *childAt(uint64_t bit) const;
+
+	static uint64_t letterBit(Letter l);
+
+	// the letter of the lowest set bit in bits, which mustn't be zero
+	static Letter lowestLetter(uint64_t bits);
+
+private:
+	friend class LexiconParameters;
+
+	uint64_t m_childLetters;
+	uint32_t m_firstChild;
+	unsigned char m_letter;
+	unsigned char m_flags;
+};
+
+inline int
+gaddagBitCount(uint64_t bits)
+{
+#if defined(_MSC_VER)
+	return (int) __popcnt64(bits);
+#else
+	return __builtin_popcountll(bits);
+#endif
+}
+
+inline Letter
+IndexedGaddagNode::letter() const
+{
+	return m_letter;
+}
+
+inline bool
+IndexedGaddagNode::isTerminal() const
+{
+	return (m_flags & 0x40) != 0;
+}
+
+inline const IndexedGaddagNode *
+IndexedGaddagNode::firstChild() const
+{
+	return m_firstChild == 0? 0 : this + m_firstChild;
+}
+
+inline const IndexedGaddagNode *
+IndexedGaddagNode::nextSibling() const
+{
+	return (m_flags & 0x80)? 0 : this + 1;
+}
+
+inline uint64_t
+IndexedGaddagNode::childLetters() const
+{
+	return m_childLetters;
+}
+
+inline const IndexedGaddagNode *
+IndexedGaddagNode::childAt(uint64_t bit) const
+{
+	return this + m_firstChild + gaddagBitCount(m_childLetters & (bit - 1));
+}
+
+inline const IndexedGaddagNode *
+IndexedGaddagNode::child(Letter l) const
+{
+	const uint64_t bit = letterBit(l);
+	if (!(m_childLetters & bit)) {
+		return 0;
+	}
+	return childAt(bit);
+}
+
+inline uint64_t
+IndexedGaddagNode::letterBit(Letter l)
+{
+	return l == QUACKLE_GADDAG_SEPARATOR? (uint64_t(1) << 63) : (uint64_t(1) << l);
+}
+
+inline Letter
+IndexedGaddagNode::lowestLetter(uint64_t bits)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+#else
+	const int index = __builtin_ctzll(bits);
+#endif
+	return index == 63? QUACKLE_GADDAG_SEPARATOR : (Letter) index;
+}
+
 }
 
 #endif
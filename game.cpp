@@ -26,6 +26,7 @@
 #include "gameparameters.h"
 #include "game.h"
 #include "generator.h"
+#include "rollout.h"
 
 // define this to get warnings when there's a problem bag
 #define DEBUG_BAG
@@ -247,10 +248,15 @@ GamePosition::GamePosition()
 	resetBag();
 }
 
-void GamePosition::kibitz(int nmoves)
+void GamePosition::kibitz(int nmoves, bool pruneToBest, int threadCount)
 {
+	int flags = exchangeAllowed()? Generator::RegularKibitz : Generator::CannotExchange;
+	if (pruneToBest)
+		flags |= Generator::PruneToBest;
+
 	Generator generator(*this);
-	generator.kibitz(nmoves, exchangeAllowed()? Generator::RegularKibitz : Generator::CannotExchange);
+	generator.setThreadCount(threadCount);
+	generator.kibitz(nmoves, flags);
 
 	m_moves = generator.kibitzList();
 
@@ -258,9 +264,9 @@ void GamePosition::kibitz(int nmoves)
 		ensureMovePrettiness(it);
 }
 
-const Move &GamePosition::staticBestMove()
+const Move &GamePosition::staticBestMove(bool pruneToBest)
 {
-	kibitz(1);
+	kibitz(1, pruneToBest);
 	return m_moves.back();
 }
 
@@ -441,11 +447,12 @@ int GamePosition::handleOverdraw(const LetterString &letters, LetterString *thro
 	return ValidOverdraw;
 }
 
-void GamePosition::makeMove(const Move &move, bool maintainBoard)
+void GamePosition::makeMove(const Move &move, bool maintainBoard, bool incrementalCrosses)
 {
 	if (!move.isChallengedPhoney())
 	{
 		Generator generator(*this);
+		generator.setIncrementalCrosses(incrementalCrosses);
 		generator.makeMove(move, maintainBoard);
 		m_board = generator.position().board();
 	}
@@ -770,6 +777,11 @@ void GamePosition::resetBag()
 }
 
 bool GamePosition::incrementTurn(const History* history)
+{
+	return incrementTurn(history, 0);
+}
+
+bool GamePosition::incrementTurn(const History *history, const vector<int> *facedTilesOnRack)
 {
 	if (gameOver() || m_players.empty())
 		return false;
@@ -789,16 +801,36 @@ bool GamePosition::incrementTurn(const History* history)
 
 		// now moveTiles is the tiles that are in play but not on rack
 		removeLetters(moveTiles.tiles());
-		if (history)
+		if (history || facedTilesOnRack)
 		{
 			PlayerList::iterator nextCurrentPlayer(m_currentPlayer);
 			nextCurrentPlayer++;
 			if (nextCurrentPlayer == m_players.end())
 				nextCurrentPlayer = m_players.begin();
-			const Quackle::PositionList positions(history->positionsFacedBy((*nextCurrentPlayer).id()));
-			if (positions.size() > 0)
-				m_tilesOnRack = positions.back().m_tilesOnRack;
-			else if (m_turnNumber > 1)
+			const int nextId = (*nextCurrentPlayer).id();
+
+			// the last of history->positionsFacedBy(nextId), without
+			// copying them all
+			bool faced = false;
+			if (history)
+			{
+				for (PositionList::const_reverse_iterator it = history->rbegin(); it != history->rend(); ++it)
+				{
+					if ((*it).playerOnTurn().id() == nextId)
+					{
+						m_tilesOnRack = (*it).m_tilesOnRack;
+						faced = true;
+						break;
+					}
+				}
+			}
+			else if ((*facedTilesOnRack)[nextId] != RolloutPosition::noTilesOnRack)
+			{
+				m_tilesOnRack = (*facedTilesOnRack)[nextId];
+				faced = true;
+			}
+
+			if (!faced && m_turnNumber > 1)
 			{
 				// this can happen inside of a simming player engine
 				// which doesn't have a full history list
@@ -91,8 +91,11 @@ public:
 	// ALSO GET COPIED!!!!!!!!!!!!!!!!!!!!!!
 	const GamePosition &operator=(const GamePosition &position);
 
-	// kibitz up to nmoves best moves; stored in move list
-	void kibitz(int nmoves = 10);
+	// kibitz up to nmoves best moves; stored in move list.
+	// If nmoves is 1 and pruneToBest is true, the generator skips
+	// plays that provably can't beat the best one found so far.
+	// threadCount threads share the generation of longer lists.
+	void kibitz(int nmoves = 10, bool pruneToBest = false, int threadCount = 1);
 
 	// get what's in the move list
 	const MoveList &moves() const;
@@ -100,8 +103,9 @@ public:
 	void setMoves(const MoveList &moves);
 
 	// kibitz (destroying previous move list)
-	// and return the best move based on static evaluation
-	const Move &staticBestMove();
+	// and return the best move based on static evaluation;
+	// pruneToBest finds the same move without generating them all
+	const Move &staticBestMove(bool pruneToBest = true);
 
 	// erase a move from move list that equals move
 	void removeMove(const Move &move);
@@ -176,7 +180,9 @@ public:
 	// back in the bag.
 	// If maintainBoard is false, the board can no longer be used
 	// with kibitzing capabilities.
-	void makeMove(const Move &move, bool maintainBoard = true);
+	// If incrementalCrosses is true, only the crosses on lines touched
+	// by the move are recomputed; otherwise all of them are rebuilt.
+	void makeMove(const Move &move, bool maintainBoard = true, bool incrementalCrosses = true);
 
 	// Used when modifying the board without going through the motions,
 	// or preparing a freshly-loaded-from-file board for analysis
@@ -446,6 +452,13 @@ protected:
 	// Returns false if one of the letters was found nowhere to be
 	// removed from.
 	bool removeLetters(const LetterString &letters);
+
+	// incrementTurn, with the tiles on rack of the position the next
+	// player last faced taken from history or else from
+	// facedTilesOnRack, which is indexed by player id
+	bool incrementTurn(const History *history, const std::vector<int> *facedTilesOnRack);
+
+	friend class RolloutPosition;
 };
 
 inline const Player &GamePosition::currentPlayer() const
@@ -16,9 +16,14 @@
  *  along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <math.h>
+#include <thread>
 
 #include "datamanager.h"
 #include "evaluator.h"
@@ -35,11 +40,12 @@ using namespace std;
 using namespace Quackle;
 
 Generator::Generator()
+	: m_moveSink(0), m_recordedMoves(0), m_moveListStale(false), m_kibitzFlags(RegularKibitz), m_leaveKey(0), m_incrementalCrosses(true), m_pruneToBest(false), m_threadCount(1)
 {
 }
 
 Generator::Generator(const GamePosition &position)
-	: m_position(position)
+	: m_moveSink(0), m_recordedMoves(0), m_moveListStale(false), m_kibitzFlags(RegularKibitz), m_position(position), m_leaveKey(0), m_incrementalCrosses(true), m_pruneToBest(false), m_threadCount(1)
 {
 }
 
@@ -52,179 +58,150 @@ void Generator::kibitz(int kibitzLength, int flags)
 	// don't just record best move, unless kibitz length is one
     setrecordall(kibitzLength > 1);
 
-	// perform actual kibitz
+	// pruning is only sound when nobody wants the runners-up
+	m_pruneToBest = (kibitzLength <= 1) && (flags & PruneToBest);
+
+	// perform actual kibitz, keeping only the best plays as they're
+	// found
+	TopMovesSink top(max(kibitzLength, 1));
+	DistinctMovesSink distinct(top);
+	m_moveSink = &distinct;
     findstaticbest(!(flags & CannotExchange));
+	m_moveSink = 0;
 
+	m_kibitzFlags = flags;
+	m_moveList.clear();
 	m_kibitzList.clear();
 
 	if (kibitzLength <= 1)
 	{
+		m_moveList.push_back(best);
 		m_kibitzList.push_back(best);
+		m_moveListStale = false;
 		return;
 	}
 
-	filterOutDuplicatePlays();
+	m_kibitzList = top.moves();
+	m_moveListStale = true;
+}
 
-	MoveList::sort(m_moveList, MoveList::Equity);
+void Generator::generateInto(MoveSink &sink, int flags)
+{
+	setrecordall(true);
+	m_pruneToBest = false;
 
-	int i = 0;
-	MoveList::iterator end(m_moveList.end());
-    for (MoveList::iterator it = m_moveList.begin(); it != end; ++it, ++i)
-	{
-		if (i >= kibitzLength)
-			break;
+	m_moveList.clear();
+	m_kibitzList.clear();
+	m_moveListStale = false;
 
-		m_kibitzList.push_back(*it);
-	}
+	m_moveSink = &sink;
+	findstaticbest(!(flags & CannotExchange));
+	m_moveSink = 0;
 }
 
-void Generator::filterOutDuplicatePlays()
+const MoveList &Generator::allPossiblePlays()
 {
-	map<int, bool> oneTilePlayMap;
-	for (MoveList::iterator it = m_moveList.begin(); it != m_moveList.end();)
+	if (m_moveListStale)
 	{
-		LetterString usedTiles = (*it).usedTiles();
-		if (usedTiles.size() == 1)
-		{
-			const LetterString &tiles = (*it).tiles();
-			int actualTileIndex = 0;
-			for (LetterString::const_iterator letterIt = tiles.begin(); letterIt != tiles.end(); ++letterIt, ++actualTileIndex)
-				if ((*letterIt) != QUACKLE_PLAYED_THRU_MARK)
-					break;
+		// kibitz kept only the plays it listed, so find them all again
+		AllMovesSink all;
+		DistinctMovesSink distinct(all);
+		m_moveSink = &distinct;
+		findstaticbest(!(m_kibitzFlags & CannotExchange));
+		m_moveSink = 0;
+
+		// as MoveList::sort(m_moveList, MoveList::Equity)
+		vector<PackedMove> &moves = all.moves();
+		stable_sort(moves.begin(), moves.end(), PackedMove::equityComparator);
+		reverse(moves.begin(), moves.end());
+
+		m_moveList.reserve(moves.size());
+		for (vector<PackedMove>::const_iterator it = moves.begin(); it != moves.end(); ++it)
+			m_moveList.push_back(it->toMove());
+		m_moveListStale = false;
+	}
 
-			const int row = (*it).startrow + ((*it).horizontal? 0 : actualTileIndex);
-			const int column = (*it).startcol + ((*it).horizontal? actualTileIndex : 0);
-			int key = row + QUACKLE_MAXIMUM_BOARD_SIZE * column + (QUACKLE_MAXIMUM_BOARD_SIZE * QUACKLE_MAXIMUM_BOARD_SIZE) * tiles[actualTileIndex];
+	return m_moveList;
+}
 
-			if (oneTilePlayMap.find(key) == oneTilePlayMap.end())
-			{
-				oneTilePlayMap[key] = true;
-				++it;
-			}
-			else
-			{
-				it = m_moveList.erase(it);
-			}
-		}
-		else
-		{
-			++it;
+void Generator::allCrosses()
+{
+	for (int row = 0; row < board().height(); row++) {
+		for (int col = 0; col < board().width(); col++) {
+			updateVCross(row, col);
+			updateHCross(row, col);
 		}
 	}
 }
 
-void Generator::allCrosses()
+void Generator::updateVCross(int row, int col)
 {
-	vector<int> vrows, vcols, hrows, hcols;
-
-	for (int i = 0; i < board().height(); i++) {
-		for (int j = 0; j < board().width(); j++) {
-			vrows.push_back(i);
-			vcols.push_back(j);
-			hrows.push_back(i);
-			hcols.push_back(j);
-		}
+	if (QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col))) {
+		board().setVCross(row, col, LetterBitset());
+		return;
 	}
 
-	// check the appropriate crosses
-	for (unsigned int i = 0; i < vrows.size(); i++) {
-		int row = vrows[i];
-		int col = vcols[i];
+	int top = row;
+	while (top > 0 && QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(top - 1, col)))
+		top--;
 
-		if (QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col))) {
-			board().setVCross(row, col, LetterBitset());
-		}
-		else { 
-			LetterString pre; 
-			if (row > 0) {
-				for (int i = row - 1; i >= 0; i--) {
-					if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(i, col))) {
-						i = -1;
-					}
-					else {
-						LetterString newpre;
-						newpre += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(board().letter(i, col));
-						newpre += pre;
-						pre = newpre;
-					}
-				}
-			}
+	LetterString pre;
+	for (int i = top; i < row; i++)
+		pre += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(board().letter(i, col));
 
-			LetterString suf;
-			if (row < board().height() - 1) {
-				for (int i = row + 1; i < board().height(); i++) {
-					if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(i, col))) {
-						i = board().height();
-					}
-					else {
-						suf += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(board().letter(i, col));
-					}
-				}
-			}
+	LetterString suf;
+	for (int i = row + 1; i < board().height() && QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(i, col)); i++)
+		suf += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(board().letter(i, col));
 
 #ifdef DEBUG_GENERATOR
-			UVcout << QUACKLE_ALPHABET_PARAMETERS->userVisible(pre) << " / " << QUACKLE_ALPHABET_PARAMETERS->userVisible(suf) << endl;
+	UVcout << QUACKLE_ALPHABET_PARAMETERS->userVisible(pre) << " / " << QUACKLE_ALPHABET_PARAMETERS->userVisible(suf) << endl;
 #endif
 
-			if (pre.empty() && suf.empty()) {
-				board().setVCross(row, col, LetterBitset().set());
-			}
-			else {
-				board().setVCross(row, col, fitbetween(pre, suf));
-			}
+	if (pre.empty() && suf.empty()) {
+		board().setVCross(row, col, LetterBitset().set());
+	}
+	else {
+		board().setVCross(row, col, fitbetween(pre, suf));
+	}
 
 #ifdef DEBUG_GENERATOR
-			UVcout << "board().vcross[" << row << "][" << col << "] = " << cross2string(board().vcross(row, col)) << endl;
+	UVcout << "board().vcross[" << row << "][" << col << "] = " << cross2string(board().vcross(row, col)) << endl;
 #endif
-		}
+}
+
+void Generator::updateHCross(int row, int col)
+{
+	if (QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col))) {
+		board().setHCross(row, col, LetterBitset());
+		return;
 	}
 
-	for (unsigned int i = 0; i < hrows.size(); i++) {
-		int row = hrows[i];
-		int col = hcols[i];
+	int left = col;
+	while (left > 0 && QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, left - 1)))
+		left--;
 
-		if (QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col))) {
-			board().setHCross(row, col, LetterBitset());
-		}
-		else { 
-			LetterString pre;
-			if (col > 0) {
-				for (int i = col - 1; i >= 0; i--) {
-					if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, i))) {
-						i = -1;
-					}
-					else {
-						LetterString newpre;
-						newpre += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(board().letter(row, i));
-						newpre += pre;
-						pre = newpre;
-					}
-				}
-			}
+	LetterString pre;
+	for (int i = left; i < col; i++)
+		pre += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(board().letter(row, i));
 
-			LetterString suf;
-			if (col < board().width() - 1) {
-				for (int i = col + 1; i < board().width(); i++) {
-					if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, i))) {
-						i = board().width();
-					}
-					else {
-						suf += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(board().letter(row, i));
-					}
-				}
-			}
-			if (pre.empty() && suf.empty()) {
-				board().setHCross(row, col, LetterBitset().set());
-			}
-			else {
-				board().setHCross(row, col, fitbetween(pre, suf));
-			}
+	LetterString suf;
+	for (int i = col + 1; i < board().width() && QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, i)); i++)
+		suf += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(board().letter(row, i));
 
 #ifdef DEBUG_GENERATOR
-			UVcout << "board().hcross[" << row << "][" << col << "] = " << cross2string(board().hcross(row, col)) << endl;
+	UVcout << QUACKLE_ALPHABET_PARAMETERS->userVisible(pre) << " / " << QUACKLE_ALPHABET_PARAMETERS->userVisible(suf) << endl;
 #endif
-		}
+
+	if (pre.empty() && suf.empty()) {
+		board().setHCross(row, col, LetterBitset().set());
+	}
+	else {
+		board().setHCross(row, col, fitbetween(pre, suf));
 	}
+
+#ifdef DEBUG_GENERATOR
+	UVcout << "board().hcross[" << row << "][" << col << "] = " << cross2string(board().hcross(row, col)) << endl;
+#endif
 }
 
 void Generator::makeMove(const Move &move, bool regenerateCrosses)
@@ -238,204 +215,107 @@ void Generator::makeMove(const Move &move, bool regenerateCrosses)
 		return;
 	}
 
-	// mark which squares need their crosses checked
-	vector<int> hrows;
-	vector<int> hcols;
-	vector<int> vrows;
-	vector<int> vcols;
-	hrows.reserve(2 * QUACKLE_MAXIMUM_BOARD_SIZE);
-	hcols.reserve(2 * QUACKLE_MAXIMUM_BOARD_SIZE);
-	vrows.reserve(2 * QUACKLE_MAXIMUM_BOARD_SIZE);
-	vcols.reserve(2 * QUACKLE_MAXIMUM_BOARD_SIZE);
+	if (!m_incrementalCrosses)
+	{
+		board().makeMove(move);
+		allCrosses();
+		return;
+	}
 
+	// Only squares on the lines touched by the newly laid tiles can
+	// change: the laid squares themselves, the squares just past either
+	// end of the move, and the first empty square above and below
+	// (or left and right of) each laid tile.
+	int hrows[2 * QUACKLE_MAXIMUM_BOARD_SIZE + 2];
+	int hcols[2 * QUACKLE_MAXIMUM_BOARD_SIZE + 2];
+	int vrows[2 * QUACKLE_MAXIMUM_BOARD_SIZE + 2];
+	int vcols[2 * QUACKLE_MAXIMUM_BOARD_SIZE + 2];
+	int hcount = 0;
+	int vcount = 0;
+
+	const int length = move.tiles().length();
+	const int rowStep = move.horizontal? 0 : 1;
+	const int colStep = move.horizontal? 1 : 0;
+	const int endrow = move.startrow + rowStep * (length - 1);
+	const int endcol = move.startcol + colStep * (length - 1);
+
+	// the squares just past either end of the move
 	if (move.horizontal) {
-		int row = move.startrow;
-		int endcol = move.startcol + move.tiles().length() - 1;
-
 		if (move.startcol > 0) {
-			hrows.push_back(row);
-			hcols.push_back(move.startcol - 1);
+			hrows[hcount] = move.startrow;
+			hcols[hcount++] = move.startcol - 1;
 		}
-
 		if (endcol < board().width() - 1) {
-			hrows.push_back(row);
-			hcols.push_back(endcol + 1); 
-		}
-
-		for (int col = move.startcol; col <= endcol; col++) {
-			if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col))) {
-				int upempty = -1;
-				for (int hookrow = row - 1; hookrow >= 0; hookrow--) {
-					if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(hookrow, col))) {
-						upempty = hookrow;
-						hookrow = -1;
-					}
-				} 
-				if (upempty >= 0) {
-					vrows.push_back(upempty);
-					vcols.push_back(col);
-				}
-
-				int downempty = board().height();
-				for (int hookrow = row + 1; hookrow < board().height(); hookrow++) {
-					if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(hookrow, col))) {
-						downempty = hookrow;
-						hookrow = board().height();
-					}
-				}
-				if (downempty < board().height()) {
-					vrows.push_back(downempty);
-					vcols.push_back(col);
-				}
-			}
+			hrows[hcount] = move.startrow;
+			hcols[hcount++] = endcol + 1;
 		}
 	}
 	else {
-		int col = move.startcol;
-		int endrow = move.startrow + move.tiles().length() - 1;
-
 		if (move.startrow > 0) {
-			vrows.push_back(move.startrow - 1);
-			vcols.push_back(col);
+			vrows[vcount] = move.startrow - 1;
+			vcols[vcount++] = move.startcol;
 		}
-
 		if (endrow < board().height() - 1) {
-			vrows.push_back(endrow + 1);
-			vcols.push_back(col); 
-		}
-
-		for (int row = move.startrow; row <= endrow; row++) {
-			if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col))) {
-				int upempty = -1;
-				for (int hookcol = col - 1; hookcol >= 0; hookcol--) {
-					if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, hookcol))) {
-						upempty = hookcol;
-						hookcol = -1;
-					}
-				} 
-				if (upempty >= 0) {
-					hrows.push_back(row);
-					hcols.push_back(upempty);
-				}
-
-				int downempty = board().width();
-				for (int hookcol = col + 1; hookcol < board().width(); hookcol++) {
-					if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, hookcol))) {
-						downempty = hookcol;
-						hookcol = board().width();
-					}
-				}
-				if (downempty < board().width()) {
-					hrows.push_back(row);
-					hcols.push_back(downempty);
-				}
-			}
+			vrows[vcount] = endrow + 1;
+			vcols[vcount++] = move.startcol;
 		}
 	}
 
-	board().makeMove(move);
+	for (int i = 0; i < length; i++) {
+		const int row = move.startrow + rowStep * i;
+		const int col = move.startcol + colStep * i;
 
-	// check the appropriate crosses
-	for (unsigned int i = 0; i < vrows.size(); i++) {
-		int row = vrows[i];
-		int col = vcols[i];
-		if (QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col))) {
-			board().setVCross(row, col, LetterBitset());
-		}
-		else { 
-			LetterString pre;
-			if (row > 0) {
-				for (int i = row - 1; i >= 0; i--) {
-					if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(i, col))) {
-						i = -1;
-					}
-					else {
-						LetterString newpre;
-						newpre += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(board().letter(i, col));
-						newpre += pre;
-						pre = newpre;
-					}
-				}
-			}
-			LetterString suf;
-			if (row < board().height() - 1) {
-				for (int i = row + 1; i < board().height(); i++) {
-					if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(i, col))) {
-						i = board().height();
-					}
-					else {
-						suf += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(board().letter(i, col));
-					}
-				}
-			}
+		// tiles played through don't change the perpendicular line
+		if (QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col)))
+			continue;
 
-#ifdef DEBUG_GENERATOR
-			UVcout << QUACKLE_ALPHABET_PARAMETERS->userVisible(pre) << " / " << QUACKLE_ALPHABET_PARAMETERS->userVisible(suf) << endl;
-#endif
+		if (move.horizontal) {
+			int hookrow = row - 1;
+			while (hookrow >= 0 && QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(hookrow, col)))
+				hookrow--;
+			if (hookrow >= 0) {
+				vrows[vcount] = hookrow;
+				vcols[vcount++] = col;
+			}
 
-			if ((pre.empty()) && (suf.empty())) {
-				board().setVCross(row, col, LetterBitset().set());
+			hookrow = row + 1;
+			while (hookrow < board().height() && QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(hookrow, col)))
+				hookrow++;
+			if (hookrow < board().height()) {
+				vrows[vcount] = hookrow;
+				vcols[vcount++] = col;
 			}
-			else {
-				board().setVCross(row, col, fitbetween(pre, suf));
+		}
+		else {
+			int hookcol = col - 1;
+			while (hookcol >= 0 && QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, hookcol)))
+				hookcol--;
+			if (hookcol >= 0) {
+				hrows[hcount] = row;
+				hcols[hcount++] = hookcol;
 			}
 
-#ifdef DEBUG_GENERATOR
-			UVcout << "board().vcross[" << row << "][" << col << "] = " << cross2string(board().vcross(row, col)) << endl;
-#endif
+			hookcol = col + 1;
+			while (hookcol < board().width() && QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, hookcol)))
+				hookcol++;
+			if (hookcol < board().width()) {
+				hrows[hcount] = row;
+				hcols[hcount++] = hookcol;
+			}
 		}
-	}
-
-	for (unsigned int i = 0; i < hrows.size(); i++) {
-		int row = hrows[i];
-		int col = hcols[i];
 
-		if (QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col))) {
-			board().setHCross(row, col, LetterBitset());
-		}
-		else { 
-			LetterString pre; 
-			if (col > 0) {
-				for (int i = col - 1; i >= 0; i--) {
-					if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, i))) {
-						i = -1;
-					}
-					else {
-						LetterString newpre;
-						newpre += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(board().letter(row, i));
-						newpre += pre;
-						pre = newpre;
-					}
-				}
-			}
-			LetterString suf;
-			if (col < board().width() - 1) {
-				for (int i = col + 1; i < board().width(); i++) {
-					if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, i))) {
-						i = board().width();
-					}
-					else {
-						suf += QUACKLE_ALPHABET_PARAMETERS->clearBlankness(board().letter(row, i));
-					}
-				}
-			}
+		// the laid square itself is now occupied
+		board().setVCross(row, col, LetterBitset());
+		board().setHCross(row, col, LetterBitset());
+	}
 
-#ifdef DEBUG_GENERATOR
-			UVcout << QUACKLE_ALPHABET_PARAMETERS->userVisible(pre) << " / " << QUACKLE_ALPHABET_PARAMETERS->userVisible(suf) << endl;
-#endif
+	board().makeMove(move);
 
-			if ((pre.empty()) && (suf.empty())) {
-				board().setHCross(row, col, LetterBitset().set());
-			}
-			else {
-				board().setHCross(row, col, fitbetween(pre, suf));
-			}
+	for (int i = 0; i < vcount; i++)
+		updateVCross(vrows[i], vcols[i]);
 
-#ifdef DEBUG_GENERATOR
-			UVcout << "board().hcross[" << row << "][" << col << "] = " << cross2string(board().hcross(row, col)) << endl;
-#endif
-		}
-	}
+	for (int i = 0; i < hcount; i++)
+		updateHCross(hrows[i], hcols[i]);
 }
 
 void Generator::readFromDawg(int index, unsigned int &p, Letter &letter, bool &t, bool &lastchild, bool &british, int &playability) const
@@ -486,7 +366,8 @@ bool Generator::checksuffix(int i, const LetterString &suffix) {
 	}
 }
 
-LetterBitset Generator::gaddagFitbetween(const LetterString &pre, const LetterString &suf)
+template <class Node>
+LetterBitset Generator::gaddagFitbetween(const Node *root, const LetterString &pre, const LetterString &suf)
 {
 // 	UVcout << "fit " 
 // 		 << QUACKLE_ALPHABET_PARAMETERS->userVisible(pre)
@@ -494,7 +375,7 @@ LetterBitset Generator::gaddagFitbetween(const LetterString &pre, const LetterSt
 // 		 << QUACKLE_ALPHABET_PARAMETERS->userVisible(suf) << endl;
 	LetterBitset crosses;
 	/* process the suffix once */
-	const GaddagNode *sufNode = QUACKLE_LEXICON_PARAMETERS->gaddagRoot();
+	const Node *sufNode = root;
 	int sufLen = suf.length();
 	for (int i = sufLen - 1; i >= 0; --i) {
 		sufNode = sufNode->child(suf[i]);
@@ -504,12 +385,12 @@ LetterBitset Generator::gaddagFitbetween(const LetterString &pre, const LetterSt
 	}
 
 	int preLen = pre.length();
-	for (const GaddagNode* node = sufNode->firstChild(); node; node = node->nextSibling()) {
+	for (const Node* node = sufNode->firstChild(); node; node = node->nextSibling()) {
 	    Letter childLetter = node->letter();
 	    if (childLetter == QUACKLE_GADDAG_SEPARATOR) {
 			break;
 	    }
-		const GaddagNode *n = node;
+		const Node *n = node;
 		for (int i = preLen - 1; i >= 0; --i) {
 			n = n->child(pre[i]);
 			if (!n) {
@@ -526,8 +407,11 @@ LetterBitset Generator::gaddagFitbetween(const LetterString &pre, const LetterSt
 
 LetterBitset Generator::fitbetween(const LetterString &pre, const LetterString &suf)
 {
+ 	if (QUACKLE_LEXICON_PARAMETERS->hasIndexedGaddag()) {
+ 		return gaddagFitbetween(QUACKLE_LEXICON_PARAMETERS->indexedGaddagRoot(), pre, suf);
+	}
  	if (QUACKLE_LEXICON_PARAMETERS->hasGaddag()) {
- 		return gaddagFitbetween(pre, suf);
+ 		return gaddagFitbetween(QUACKLE_LEXICON_PARAMETERS->gaddagRoot(), pre, suf);
 	}
 
 	//UVcout << QUACKLE_ALPHABET_PARAMETERS->userVisible(pre) << "_" <<
@@ -603,7 +487,8 @@ UVString Generator::cross2string(const LetterBitset &cross)
    Gen(pos + 1, word, rack, NewArc)
  */
 
-void Generator::gordongoon(int pos, char L, LetterString word, const GaddagNode *node)
+template <class Node>
+void Generator::gordongoon(int pos, char L, LetterString word, const Node *node)
 {
 	//UVcout << "gordongoon(" << pos << ", " << L << ", " << word << ", " << newarc << ", " << oldarc << ")" << 
 	//        " horiz: " << m_gordonhoriz << endl;
@@ -670,15 +555,7 @@ void Generator::gordongoon(int pos, char L, LetterString word, const GaddagNode
 
 			move.horizontal = m_gordonhoriz;
 			move.score = board().score(move, &move.isBingo);
-			move.equity = equity(move);
-
-			if (m_recordall) {
-				m_moveList.push_back(move);
-			}
-
-			if (MoveList::equityComparator(best, move)) {
-				best = move;
-			}
+			foundPlay(move, m_leaveKey);
 			// UVcout << "found a move: " << move << " score: " << move.score << ", equity: " << move.equity << 
 			// " outputted by leftmoving loop" << endl;
 		}
@@ -774,15 +651,7 @@ void Generator::gordongoon(int pos, char L, LetterString word, const GaddagNode
 
 			move.horizontal = m_gordonhoriz;
 			move.score = board().score(move, &move.isBingo);
-			move.equity = equity(move);
-
-			if (m_recordall) {
-				m_moveList.push_back(move);
-			}
-
-			if (MoveList::equityComparator(best, move)) {
-				best = move;
-			}
+			foundPlay(move, m_leaveKey);
 			// UVcout << "found a move: " << move << " score: " << move.score << ", equity: " << move.equity << 
 			//      " outputted by rightmoving loop" << endl;
 		}
@@ -797,7 +666,8 @@ void Generator::gordongoon(int pos, char L, LetterString word, const GaddagNode
 	}
 }
 
-void Generator::gordongen(int pos, const LetterString &word, const GaddagNode *node) 
+template <class Node>
+void Generator::gordongen(int pos, const LetterString &word, const Node *node) 
 {
 	// UVcout << "gordongen(" << pos << ", " << word << ", " << i << ")" << " horiz: " << m_gordonhoriz << endl;
 
@@ -811,6 +681,10 @@ void Generator::gordongen(int pos, const LetterString &word, const GaddagNode *n
 		currow += pos;
 	}
 
+	if (m_pruneToBest && cannotBeatBest(pos)) {
+		return;
+	}
+
 	LetterBitset cross;
 	if (m_gordonhoriz) {
 		cross = board().vcross(currow, curcol);
@@ -824,53 +698,99 @@ void Generator::gordongen(int pos, const LetterString &word, const GaddagNode *n
 
 		Letter boardc = QUACKLE_ALPHABET_PARAMETERS->clearBlankness(board().letter(currow, curcol));
 
-		const GaddagNode *child = node->child(boardc);
+		const Node *child = node->child(boardc);
 		if (child) {
 			gordongoon(pos, board().letter(currow, curcol), word, child);
 		}
 	}
 
 	else {
+		gordonTiles(pos, word, node, cross);
+	}
+}
+
+void Generator::gordonTiles(int pos, const LetterString &word, const GaddagNode *node, const LetterBitset &cross)
+{
+	for (const GaddagNode* child = node->firstChild(); child; child = child->nextSibling()) {
+		Letter childLetter = child->letter();
+
+		if ((m_counts[childLetter] <= 0) 
+				|| !cross.test(childLetter - QUACKLE_FIRST_LETTER)) {
+			continue;
+		}
+
+		if (childLetter == QUACKLE_GADDAG_SEPARATOR) {
+			// UVcout << "ran into a delimiter" << endl;
+			break;
+		}
+
+		m_counts[childLetter]--;
+		m_leaveKey -= m_leaveStrides[childLetter];
+		m_laid++;
+		// UVcout << "    yeah that'll work" << endl;
+		gordongoon(pos, childLetter, word, child);
+		m_counts[childLetter]++;
+		m_leaveKey += m_leaveStrides[childLetter];
+		m_laid--;
+
+	}
+	if (m_counts[QUACKLE_BLANK_MARK] >= 1) {
 		for (const GaddagNode* child = node->firstChild(); child; child = child->nextSibling()) {
 			Letter childLetter = child->letter();
-
-			if ((m_counts[childLetter] <= 0) 
-					|| !cross.test(childLetter - QUACKLE_FIRST_LETTER)) {
-				continue;
-			}
+			// UVcout << "childLetter is " << (char)(arcc + 'A') << endl;
 
 			if (childLetter == QUACKLE_GADDAG_SEPARATOR) {
 				// UVcout << "ran into a delimiter" << endl;
 				break;
 			}
 
-			m_counts[childLetter]--;
-			m_laid++;
-			// UVcout << "    yeah that'll work" << endl;
-			gordongoon(pos, childLetter, word, child);
-			m_counts[childLetter]++;
-			m_laid--;
+			if (cross.test(childLetter - QUACKLE_FIRST_LETTER)) {
+				m_counts[QUACKLE_BLANK_MARK]--;
+				m_leaveKey -= m_leaveStrides[QUACKLE_BLANK_MARK];
+				m_laid++;
+				// UVcout << "    yeah that'll work" << endl;
+				gordongoon(pos, QUACKLE_ALPHABET_PARAMETERS->setBlankness(childLetter), word, child);
+				m_counts[QUACKLE_BLANK_MARK]++;
+				m_leaveKey += m_leaveStrides[QUACKLE_BLANK_MARK];
+				m_laid--;
+			}
+		}
+	}
+}
 
+void Generator::gordonTiles(int pos, const LetterString &word, const IndexedGaddagNode *node, const LetterBitset &cross)
+{
+	// cross bit i is letter i + QUACKLE_FIRST_LETTER, and never the separator
+	const uint64_t fits = node->childLetters() & (cross.to_ullong() << QUACKLE_FIRST_LETTER);
+
+	for (uint64_t bits = fits & m_rackLetterBits; bits; bits &= bits - 1) {
+		const Letter childLetter = IndexedGaddagNode::lowestLetter(bits);
+		const uint64_t bit = bits & ~(bits - 1);
+
+		if (--m_counts[childLetter] == 0) {
+			m_rackLetterBits &= ~bit;
 		}
-		if (m_counts[QUACKLE_BLANK_MARK] >= 1) {
-			for (const GaddagNode* child = node->firstChild(); child; child = child->nextSibling()) {
-				Letter childLetter = child->letter();
-				// UVcout << "childLetter is " << (char)(arcc + 'A') << endl;
+		m_leaveKey -= m_leaveStrides[childLetter];
+		m_laid++;
+		gordongoon(pos, childLetter, word, node->childAt(bit));
+		m_counts[childLetter]++;
+		m_rackLetterBits |= bit;
+		m_leaveKey += m_leaveStrides[childLetter];
+		m_laid--;
+	}
 
-				if (childLetter == QUACKLE_GADDAG_SEPARATOR) {
-					// UVcout << "ran into a delimiter" << endl;
-					break;
-				}
+	if (m_counts[QUACKLE_BLANK_MARK] >= 1) {
+		for (uint64_t bits = fits; bits; bits &= bits - 1) {
+			const Letter childLetter = IndexedGaddagNode::lowestLetter(bits);
+			const uint64_t bit = bits & ~(bits - 1);
 
-				if (cross.test(childLetter - QUACKLE_FIRST_LETTER)) {
-					m_counts[QUACKLE_BLANK_MARK]--;
-					m_laid++;
-					// UVcout << "    yeah that'll work" << endl;
-					gordongoon(pos, QUACKLE_ALPHABET_PARAMETERS->setBlankness(childLetter), word, child);
-					m_counts[QUACKLE_BLANK_MARK]++;
-					m_laid--;
-				}
-			}
+			m_counts[QUACKLE_BLANK_MARK]--;
+			m_leaveKey -= m_leaveStrides[QUACKLE_BLANK_MARK];
+			m_laid++;
+			gordongoon(pos, QUACKLE_ALPHABET_PARAMETERS->setBlankness(childLetter), word, node->childAt(bit));
+			m_counts[QUACKLE_BLANK_MARK]++;
+			m_leaveKey += m_leaveStrides[QUACKLE_BLANK_MARK];
+			m_laid--;
 		}
 	}
 }
@@ -946,7 +866,6 @@ void Generator::extendright(const LetterString &partial, int i,
 						}
 						move.horizontal = horizontal;
 						move.score = board().score(move, &move.isBingo);
-						move.equity = equity(move);
 
 						// i added this because m_laid is wrong and i don't want to break anything by fixing it :)
 						// will need to remember to add this bit to the DAGGAD code when we start using it again
@@ -957,13 +876,7 @@ void Generator::extendright(const LetterString &partial, int i,
 						
 						if (1 || !ignore)
 						{
-							if (m_recordall) {
-								m_moveList.push_back(move);
-							}
-
-							if (MoveList::equityComparator(best, move)) {
-								best = move;
-							}
+							foundPlay(move, m_leaveKey - m_leaveStrides[c]);
 
 #ifdef DEBUG_GENERATOR
 							UVcout << "found a move: " << move << " laid: " << m_laid << ", score: " << move.score << ", equity: " << move.equity << endl;
@@ -973,10 +886,12 @@ void Generator::extendright(const LetterString &partial, int i,
 				}
 				if (dirpos < edgeDirpos) {
 					m_counts[c]--;
+					m_leaveKey -= m_leaveStrides[c];
 					m_laid++;
 					extendright(partial + c, p, row, col, 
 							0, righttiles + 1, horizontal);
 					m_counts[c]++;
+					m_leaveKey += m_leaveStrides[c];
 					m_laid--;
 				}
 			}
@@ -1011,7 +926,6 @@ void Generator::extendright(const LetterString &partial, int i,
 						}
 						move.horizontal = horizontal;
 						move.score = board().score(move, &move.isBingo);
-						move.equity = equity(move);
 
 						int laid = move.wordTilesWithNoPlayThru().length();
 						bool onetilevert = (!move.horizontal) && (laid == 1);
@@ -1019,13 +933,7 @@ void Generator::extendright(const LetterString &partial, int i,
 																								
 						if (1 || !ignore)
 						{
-							if (m_recordall) { 
-								m_moveList.push_back(move);
-							}
-
-							if (MoveList::equityComparator(best, move)) {
-								best = move;
-							}
+							foundPlay(move, m_leaveKey - m_leaveStrides[QUACKLE_BLANK_MARK]);
 #ifdef DEBUG_GENERATOR
 							UVcout << "found a move: " << move << " laid: " << m_laid << ", score: " << move.score << ", equity: " << move.equity << endl;
 
@@ -1035,10 +943,12 @@ void Generator::extendright(const LetterString &partial, int i,
 				}
 				if (dirpos < edgeDirpos) {
 					m_counts[QUACKLE_BLANK_MARK]--;
+					m_leaveKey -= m_leaveStrides[QUACKLE_BLANK_MARK];
 					m_laid++;
 					extendright(partial + QUACKLE_ALPHABET_PARAMETERS->setBlankness(c), p, row, col, 
 							0, righttiles + 1, horizontal);
 					m_counts[QUACKLE_BLANK_MARK]++;
+					m_leaveKey += m_leaveStrides[QUACKLE_BLANK_MARK];
 					m_laid--;
 				}
 			}
@@ -1102,7 +1012,6 @@ void Generator::extendright(const LetterString &partial, int i,
 					}
 					move.horizontal = horizontal;
 					move.score = board().score(move, &move.isBingo);
-					move.equity = equity(move);
 						
 					int laid = move.wordTilesWithNoPlayThru().length();
 					bool onetilevert = (!move.horizontal) && (laid == 1);
@@ -1111,13 +1020,7 @@ void Generator::extendright(const LetterString &partial, int i,
 					if (1 || !ignore)
 					{
 						
-						if (m_recordall) {
-							m_moveList.push_back(move);
-						}
-
-						if (MoveList::equityComparator(best, move)) {
-							best = move;
-						}
+						foundPlay(move, m_leaveKey);
 
 #ifdef DEBUG_GENERATOR
 						UVcout << "found a move: " << move << " which has equity " << move.equity << endl;
@@ -1162,17 +1065,21 @@ void Generator::leftpart(const LetterString &partial, int i, int limit,
 
 		if (m_counts[c] >= 1) {
 			m_counts[c]--;
+			m_leaveKey -= m_leaveStrides[c];
 			m_laid++;
 			leftpart(partial + c, p, limit - 1, row, col, 0, horizontal);
 			m_counts[c]++;
+			m_leaveKey += m_leaveStrides[c];
 			m_laid--;
 		}
 
 		if (m_counts[QUACKLE_BLANK_MARK] >= 1) {
 			m_counts[QUACKLE_BLANK_MARK]--;
+			m_leaveKey -= m_leaveStrides[QUACKLE_BLANK_MARK];
 			m_laid++;
 			leftpart(partial + QUACKLE_ALPHABET_PARAMETERS->setBlankness(c), p, limit - 1, row, col, 0, horizontal);
 			m_counts[QUACKLE_BLANK_MARK]++;
+			m_leaveKey += m_leaveStrides[QUACKLE_BLANK_MARK];
 			m_laid--;
 		}
 
@@ -1192,262 +1099,533 @@ double Generator::equity(const Move &move) const
 	return QUACKLE_EVALUATOR->equity(m_position, move);
 }
 
+double Generator::equity(const Move &move, int leaveKey) const
+{
+	return QUACKLE_EVALUATOR->equity(m_position, move, m_leaveValues[leaveKey]);
+}
+
+// as MoveList::equityComparator(best, move); a play found twice
+// doesn't beat itself
+static bool beatsBest(const PackedMove &best, const PackedMove &move)
+{
+	if (move.equity != best.equity)
+		return best.equity < move.equity;
+
+	if (move.startrow == best.startrow && move.startcol == best.startcol && move.horizontal == best.horizontal && move.score == best.score && move.length == best.length && equal(move.tiles, move.tiles + move.length, best.tiles))
+		return false;
+
+	return PackedMove::equityComparator(best, move);
+}
+
+void Generator::foundPlay(Move &move, int leaveKey)
+{
+	if (m_recordall) {
+		m_pendingPlays.push_back(PackedMove(move));
+		m_pendingLeaveValues.push_back(m_leaveValues[leaveKey]);
+		return;
+	}
+
+	move.equity = equity(move, leaveKey);
+	if (MoveList::equityComparator(best, move)) {
+		best = move;
+	}
+}
+
+void Generator::recordPendingPlays()
+{
+	if (m_pendingPlays.empty())
+		return;
+
+	QUACKLE_EVALUATOR->equity(m_position, m_pendingPlays.data(), m_pendingLeaveValues.data(), m_pendingPlays.size());
+
+	PackedMove packedBest(best);
+	bool bestChanged = false;
+	for (vector<PackedMove>::const_iterator it = m_pendingPlays.begin(); it != m_pendingPlays.end(); ++it) {
+		recordMove(*it);
+		if (beatsBest(packedBest, *it)) {
+			packedBest = *it;
+			bestChanged = true;
+		}
+	}
+
+	if (bestChanged)
+		best = packedBest.toMove();
+
+	m_pendingPlays.clear();
+	m_pendingLeaveValues.clear();
+}
+
+void Generator::prepareLeaves()
+{
+	const LetterString &tiles = rack().tiles();
+	const int tileCount = tiles.length();
+
+	memset(m_leaveStrides, 0, sizeof(m_leaveStrides));
+	int keys = 1;
+	for (int i = 0; i < tileCount; i++) {
+		const Letter letter = tiles[i];
+		if (m_leaveStrides[letter] == 0) {
+			m_leaveStrides[letter] = keys;
+			keys *= m_counts[letter] + 1;
+		}
+	}
+
+	// the whole rack is left before anything is laid
+	m_leaveKey = keys - 1;
+
+	m_leaveValues.resize(keys);
+	for (int key = 0; key < keys; key++) {
+		// Leave the tiles in the order rack() - move would: laying a
+		// letter takes its first tiles off the rack.
+		int seen[QUACKLE_FIRST_LETTER + QUACKLE_MAXIMUM_ALPHABET_SIZE] = { 0 };
+		LetterString leave;
+		for (int i = 0; i < tileCount; i++) {
+			const Letter letter = tiles[i];
+			const int left = key / m_leaveStrides[letter] % (m_counts[letter] + 1);
+			if (seen[letter]++ >= m_counts[letter] - left)
+				leave += letter;
+		}
+
+		m_leaveValues[key] = QUACKLE_EVALUATOR->leaveValue(leave);
+	}
+
+	// each subset is a smaller one plus its lowest tile
+	m_usedTileLeaveKeys.resize(1 << tileCount);
+	m_usedTileLeaveKeys[0] = m_leaveKey;
+	for (int mask = 1; mask < (1 << tileCount); mask++) {
+		int lowest = 0;
+		while (!(mask & (1 << lowest)))
+			lowest++;
+		const Letter letter = tiles[lowest];
+		m_usedTileLeaveKeys[mask] = m_usedTileLeaveKeys[mask & (mask - 1)] - m_leaveStrides[letter];
+	}
+}
+
 Move Generator::generate()
 {
 #ifdef DEBUG_GENERATOR
 	UVcout << "generate called" << endl;
 #endif
 
+	vector<Anchor> anchors;
 	for (int row = 0; row < board().height(); row++) {
-		for (int col = 0; col < board().width(); col++) {
-
-			// generate horizontal plays
+		const uint64_t hanchors = board().dawgAnchors(row, true);
+		const uint64_t vanchors = board().dawgAnchors(row, false);
 
-			// what defines an anchor square?
+		int col = 0;
+		for (uint64_t bits = hanchors | vanchors; bits; bits >>= 1, col++) {
+			if (!(bits & 1))
+				continue;
 
-			bool anchor = false;
-			if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col)) && !board().vcross(row, col).all()) {
-				if (col == 0) {
-					anchor = true;
-				}
-				else if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col - 1))) {
-					anchor = true;
-				}
+			// horizontal plays first, then vertical
+			if (hanchors & (uint64_t(1) << col)) {
+				Anchor anchor = { row, col, true };
+				anchors.push_back(anchor);
 			}
-			else if (QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col))) {
-				if (col == 0) {
-					anchor = true;
-				}
-				else if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col - 1))) {
-					anchor = true;
-				}
+			if (vanchors & (uint64_t(1) << col)) {
+				Anchor anchor = { row, col, false };
+				anchors.push_back(anchor);
 			}
+		}
+	}
 
-			if (anchor) {
-				int k = 0;
-				for (int i = col - 1; i >= 0; i--)
-				{
-					// UVcout << "board().vcross[" << row << "][" << i << "] = " << board().vcross(row, i) << endl;
-					
-					if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, i)) && board().vcross(row, i).all()) {
-						if (i == 0) {
-							k++;
-						}
-						else if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, i - 1))) {
-							k++;
-						}
-					}
-					else {
-						i = -1;
-					}
-				}
+	generateAnchors(anchors, false);
+	return best;
+}
+
+void Generator::dawgAnchor(int row, int col, bool horizontal)
+{
+	int k = board().dawgAnchorLimit(row, col, horizontal);
 
 #ifdef DEBUG_GENERATOR
-				UVcout << "looking horizontally with the " << QUACKLE_ALPHABET_PARAMETERS->userVisible(board().letter(row, col)) << " at " << row + 1 << (char)(col + 'A') << endl;
-				UVcout << "Apparently there are " << k << " empty spots to our left" << endl;
+	UVcout << "looking " << (horizontal? "horizontally" : "vertically") << " with the " << QUACKLE_ALPHABET_PARAMETERS->userVisible(board().letter(row, col)) << " at " << row + 1 << (char)(col + 'A') << endl;
+	UVcout << "Apparently there are " << k << " empty spots to our left" << endl;
 #endif
 
-				m_laid = 0;
-				leftpart(LetterString(), 1, k, row, col, 0, true);
-			}
+	m_laid = 0;
+	leftpart(LetterString(), 1, k, row, col, 0, horizontal);
+	recordPendingPlays();
+}
 
-			// generate vertical plays
+void Generator::generateAnchors(const vector<Anchor> &anchors, bool gaddag)
+{
+	const int threadCount = min<int>(m_threadCount, anchors.size());
+
+	// Only a full move list is worth splitting; the best move alone
+	// comes from one pass, pruned or not.
+	if (threadCount <= 1 || !m_recordall) {
+		for (vector<Anchor>::const_iterator it = anchors.begin(); it != anchors.end(); ++it) {
+			if (gaddag)
+				gordonAnchor(it->row, it->col, it->horizontal);
+			else
+				dawgAnchor(it->row, it->col, it->horizontal);
+		}
+		return;
+	}
 
-			// what defines an anchor square?
+	// This generator is the first worker. Workers take anchors in order
+	// as they free up, and note where each anchor's plays landed in
+	// their move lists so these can be stitched back in anchor order.
+	struct Segment
+	{
+		int worker;
+		size_t begin, end;
+	};
+
+	// Each worker records into its own list, including this one, whose
+	// sink gets the stitched plays afterwards.
+	vector<AllMovesSink> found(threadCount);
+	vector<Generator> others(threadCount - 1, *this);
+	for (int worker = 1; worker < threadCount; ++worker)
+		others[worker - 1].m_moveSink = &found[worker];
+
+	MoveSink *sink = m_moveSink;
+	const size_t recordedMoves = m_recordedMoves;
+	m_moveSink = &found[0];
+
+	vector<Segment> segments(anchors.size());
+	atomic<size_t> nextAnchor(0);
+
+	auto work = [&](int worker) {
+		Generator &generator = worker == 0? *this : others[worker - 1];
+		const vector<PackedMove> &moves = found[worker].moves();
+		for (size_t i = nextAnchor++; i < anchors.size(); i = nextAnchor++) {
+			segments[i].worker = worker;
+			segments[i].begin = moves.size();
+			if (gaddag)
+				generator.gordonAnchor(anchors[i].row, anchors[i].col, anchors[i].horizontal);
+			else
+				generator.dawgAnchor(anchors[i].row, anchors[i].col, anchors[i].horizontal);
+			segments[i].end = moves.size();
+		}
+	};
+
+	vector<thread> threads;
+	for (int worker = 1; worker < threadCount; ++worker)
+		threads.push_back(thread(work, worker));
+	work(0);
+	for (vector<thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+		it->join();
+
+	m_moveSink = sink;
+	m_recordedMoves = recordedMoves;
+	for (vector<Segment>::const_iterator it = segments.begin(); it != segments.end(); ++it) {
+		const vector<PackedMove> &moves = found[it->worker].moves();
+		for (size_t i = it->begin; i < it->end; ++i)
+			recordMove(moves[i]);
+	}
 
-			anchor = false;
-			if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col)) && !board().hcross(row, col).all()) {
-				if (row == 0) {
-					anchor = true;
-				}
-				else if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row - 1, col))) {
-					anchor = true;
-				}
-			}
-			else if (QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col))) {
-				if (row == 0) {
-					anchor = true;
-				}
-				else if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row - 1, col))) {
-					anchor = true;
-				}
-			}
+	// equityComparator is a total order, so this is the same best move
+	// a single thread finds
+	for (vector<Generator>::const_iterator it = others.begin(); it != others.end(); ++it)
+		if (MoveList::equityComparator(best, it->best))
+			best = it->best;
+}
 
-			if (anchor) {
-				int k = 0;
-				for (int i = row - 1; i >= 0; i--) {
-					// UVcout << "board().vcross[" << row << "][" << i << "] = " << board().vcross(row, i) << endl;
-					if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(i, col)) && board().hcross(i, col).all()) {
-						if (i == 0) {
-							k++;
-						}
-						else if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(i - 1, col))) {
-							k++;
-						}
-					}
-					else {
-						i = -1;
+Move Generator::gordongenerate()
+{
+	if (m_pruneToBest) {
+		struct BoundedAnchor
+		{
+			double bound;
+			int row, col;
+			bool horizontal;
+			bool operator>(const BoundedAnchor &other) const { return bound > other.bound; }
+		};
+
+		prepareEquityBounds();
+
+		vector<BoundedAnchor> anchors;
+		for (int row = 0; row < board().height(); row++) {
+			for (int dir = 0; dir < 2; dir++) {
+				const bool horizontal = (dir == 0);
+				int col = 0;
+				for (uint64_t bits = board().gaddagAnchors(row, horizontal); bits; bits >>= 1, col++) {
+					if (bits & 1) {
+						BoundedAnchor anchor = { anchorEquityBound(row, col, horizontal), row, col, horizontal };
+						anchors.push_back(anchor);
 					}
 				}
+			}
+		}
 
-#ifdef DEBUG_GENERATOR
-				UVcout << "looking vertically with the " << board().letter(row, col) << " at " << row + 1 << (char)(col + 'A') << endl;
-				UVcout << "Apparently there are " << k << " empty spots to our left" << endl;
-#endif
+		// The best move is the maximum under a total order, so the order
+		// in which anchors are tried doesn't change it. Trying the most
+		// promising anchors first lets us stop as early as possible.
+		sort(anchors.begin(), anchors.end(), greater<BoundedAnchor>());
+
+		for (vector<BoundedAnchor>::const_iterator it = anchors.begin(); it != anchors.end(); ++it) {
+			// leave a little slack for rounding in the bound
+			if (it->bound < best.equity - 1e-6)
+				break;
+
+			// recompute to set up the per-tile bounds for this anchor
+			anchorEquityBound(it->row, it->col, it->horizontal);
+			gordonAnchor(it->row, it->col, it->horizontal);
+		}
+
+		return best;
+	}
+
+	vector<Anchor> anchors;
+	for (int row = 0; row < board().height(); row++) {
+		const uint64_t hanchors = board().gaddagAnchors(row, true);
+		const uint64_t vanchors = board().gaddagAnchors(row, false);
 
-				m_laid = 0;
-				leftpart(LetterString(), 1, k, row, col, 0, false);
+		int col = 0;
+		for (uint64_t bits = hanchors | vanchors; bits; bits >>= 1, col++) {
+			if (!(bits & 1))
+				continue;
+
+			// horizontal plays first, then vertical
+			if (hanchors & (uint64_t(1) << col)) {
+				Anchor anchor = { row, col, true };
+				anchors.push_back(anchor);
+			}
+			if (vanchors & (uint64_t(1) << col)) {
+				Anchor anchor = { row, col, false };
+				anchors.push_back(anchor);
 			}
 		}
 	}
 
+	generateAnchors(anchors, true);
 	return best;
 }
 
-// TODO GET RID OF CODE DUPLICATION
-Move Generator::gordongenerate()
+void Generator::gordonAnchor(int row, int col, bool horizontal)
 {
-	for (int row = 0; row < board().height(); row++) {
-		for (int col = 0; col < board().width(); col++) {
+	// UVcout << "looking " << (horizontal? "horizontally" : "vertically") << " with the " << board().letter(row, col) <<
+	//         " at " << row + 1 << (char)(col + 'A') << endl;
 
-			// generate horizontal plays
-			// what defines an anchor square?
-			bool anchor = false;
-			if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col)) && !board().vcross(row, col).all()) {
-				if (col == 0) {
-					if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col + 1))) {
-						anchor = true;
-					}
-				}
-				else if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col - 1))) {
-					if (col == board().width() - 1) {
-						anchor = true;
-					}
-					else {
-						if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col + 1))) {
-							anchor = true;
-						}
-					}
-				}
-			}
-			else if (QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col))) {
-				if (col == board().width() - 1) {
-					anchor = true;
-				}
-				else if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col + 1))) {
-					anchor = true;
-				}
-			}
+	m_anchorrow = row;
+	m_anchorcol = col;
+	m_gordonhoriz = horizontal;
+	m_laid = 0;
+	m_leftlimit = board().gaddagAnchorLimit(row, col, horizontal);
 
-			if (anchor) {
-				int k = 0;
-				for (int i = col; i >= 0; i--) { // skip over filled sqs
-					if (QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, i))) {
-						k++;
-					} else {
-						i = -1;
-					}
-				}
-				for (int i = col - k - 1; i >= 0; i--) {
-					// UVcout << "board().vcross[" << row << "][" << i << "] = " << board().vcross(row, i) << endl;
-					if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, i)) && board().vcross(row, i).all()) {
-						if (i == 0) {
-							k++;
-						}
-						else if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, i - 1))) {
-							k++;
-						}
-					}
-					else {
-						i = -1;
-					}
-				}
-				// UVcout << "Apparently there are " << k << " empty spots to our left" << endl;
-				// leftpart("", 1, k, row, col, 0, true);
-
-				// UVcout << "looking horizontally with the " << board().letter(row, col) <<
-				//         " at " << row + 1 << (char)(col + 'A') << endl;
-
-				m_anchorrow = row;
-				m_anchorcol = col;
-				m_gordonhoriz = true;
-				m_laid = 0;
-				m_leftlimit = k;
-				gordongen(0, LetterString(), QUACKLE_LEXICON_PARAMETERS->gaddagRoot());
+	if (QUACKLE_LEXICON_PARAMETERS->hasIndexedGaddag()) {
+		m_rackLetterBits = 0;
+		for (Letter letter = QUACKLE_FIRST_LETTER; letter <= QUACKLE_ALPHABET_PARAMETERS->lastLetter(); ++letter) {
+			if (m_counts[letter] > 0) {
+				m_rackLetterBits |= IndexedGaddagNode::letterBit(letter);
 			}
+		}
+		gordongen(0, LetterString(), QUACKLE_LEXICON_PARAMETERS->indexedGaddagRoot());
+	}
+	else {
+		gordongen(0, LetterString(), QUACKLE_LEXICON_PARAMETERS->gaddagRoot());
+	}
 
-			// generate vertical plays
-			// what defines an anchor square?
+	recordPendingPlays();
+}
 
-			anchor = false;
-			if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col)) && !board().hcross(row, col).all()) {
-				if (row == 0) {
-					if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row + 1, col))) {
-						anchor = true;
-					}
-				}
-				else if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row - 1, col))) {
-					if (row == board().height() - 1) {
-						anchor = true;
-					}
-					else {
-						if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row + 1, col))) {
-							anchor = true;
-						}
-					}
-				}
-			}
-			else if (QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row, col))) {
-				if (row == board().height() - 1) {
-					anchor = true;
-				}
-				else if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(row + 1, col))) {
-					anchor = true;
-				}
-			}
+void Generator::prepareEquityBounds()
+{
+	const LetterString &tiles = rack().tiles();
+	const int tileCount = tiles.length();
+
+	m_rackScoreCount = tileCount;
+	for (int i = 0; i < tileCount; i++)
+		m_rackScores[i] = QUACKLE_ALPHABET_PARAMETERS->isPlainLetter(tiles[i])? QUACKLE_ALPHABET_PARAMETERS->score(tiles[i]) : 0;
+	sort(m_rackScores, m_rackScores + tileCount, greater<int>());
+
+	m_rackLetters.reset();
+	m_rackHasBlank = false;
+	for (int i = 0; i < tileCount; i++) {
+		if (QUACKLE_ALPHABET_PARAMETERS->isPlainLetter(tiles[i]))
+			m_rackLetters.set(tiles[i] - QUACKLE_FIRST_LETTER);
+		else
+			m_rackHasBlank = true;
+	}
 
-			if (anchor) {
-				int k = 0;
-				for (int i = row; i >= 0; i--) {
-					if (QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(i, col))) {
-						k++;
-					} else {
-						i = -1;
-					}
-				}
-				for (int i = row - k - 1; i >= 0; i--) {
-					// UVcout << "board().vcross[" << row << "][" << i << "] = " << board().vcross(row, i) << endl;
-					if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(i, col)) && board().hcross(i, col).all()) {
-						if (i == 0) {
-							k++;
-						}
-						else if (!QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(i - 1, col))) {
-							k++;
-						}
-					}
-					else {
-						i = -1;
-					}
-				}
+	// Evaluate a scoreless probe play for every subset of the rack;
+	// whatever the evaluator adds on top of the score depends only on
+	// the tiles used.
+	for (int i = 0; i <= tileCount; i++)
+		m_bestRackEquity[i] = -1e9;
+
+	for (int mask = 1; mask < (1 << tileCount); mask++) {
+		Move probe;
+		probe.action = Move::Place;
+		probe.score = 0;
+
+		LetterString used;
+		for (int i = 0; i < tileCount; i++)
+			if (mask & (1 << i))
+				used += tiles[i];
+		probe.setTiles(used);
+
+		const double value = equity(probe, m_usedTileLeaveKeys[mask]);
+		if (value > m_bestRackEquity[used.length()])
+			m_bestRackEquity[used.length()] = value;
+	}
+}
 
-				// UVcout << "Apparently there are " << k << " empty spots to our left" << endl;
-				// leftpart("", 1, k, row, col, 0, false);
+double Generator::anchorEquityBound(int row, int col, bool horizontal)
+{
+	const int lineLength = horizontal? board().width() : board().height();
+	const int anchor = horizontal? col : row;
+
+	bool filled[QUACKLE_MAXIMUM_BOARD_SIZE];
+	bool usable[QUACKLE_MAXIMUM_BOARD_SIZE];
+	int letterMultipliers[QUACKLE_MAXIMUM_BOARD_SIZE];
+	int wordMultipliers[QUACKLE_MAXIMUM_BOARD_SIZE];
+
+	// running sums along the line of played-through tile scores and of
+	// the most each empty square could score as a hook
+	int playedThruBefore[QUACKLE_MAXIMUM_BOARD_SIZE + 1];
+	int hookScoreBefore[QUACKLE_MAXIMUM_BOARD_SIZE + 1];
+	playedThruBefore[0] = hookScoreBefore[0] = 0;
+
+	for (int i = 0; i < lineLength; i++) {
+		const int r = horizontal? row : i;
+		const int c = horizontal? i : col;
+
+		filled[i] = QUACKLE_ALPHABET_PARAMETERS->isSomeLetter(board().letter(r, c));
+		playedThruBefore[i + 1] = playedThruBefore[i];
+		hookScoreBefore[i + 1] = hookScoreBefore[i];
+
+		if (filled[i]) {
+			usable[i] = true;
+			if (!board().isBlank(r, c))
+				playedThruBefore[i + 1] += QUACKLE_ALPHABET_PARAMETERS->score(board().letter(r, c));
+			continue;
+		}
+
+		// an empty square is no good if its cross rules out all our tiles
+		const LetterBitset &cross = horizontal? board().vcross(r, c) : board().hcross(r, c);
+		usable[i] = m_rackHasBlank || (cross & m_rackLetters).any();
+		letterMultipliers[i] = QUACKLE_BOARD_PARAMETERS->letterMultiplier(r, c);
+		wordMultipliers[i] = QUACKLE_BOARD_PARAMETERS->wordMultiplier(r, c);
+
+		// tiles of the perpendicular word this square would join
+		const int perpendicular = board().hookScore(r, c, horizontal);
 
-				// UVcout << "looking vertically with the " << board().letter(row, col) <<
-				//         " at " << row + 1 << (char)(col + 'A') << endl;
+		if (perpendicular >= 0) {
+			// the best tile of ours that fits the cross
+			int tileScore = 0;
+			const LetterString &tiles = rack().tiles();
+			for (LetterString::const_iterator it = tiles.begin(); it != tiles.end(); ++it)
+				if (QUACKLE_ALPHABET_PARAMETERS->isPlainLetter(*it) && cross.test(*it - QUACKLE_FIRST_LETTER))
+					tileScore = max(tileScore, QUACKLE_ALPHABET_PARAMETERS->score(*it));
 
-				m_anchorrow = row;
-				m_anchorcol = col;
-				m_gordonhoriz = false;
-				m_laid = 0;
-				m_leftlimit = k;
-				gordongen(0, LetterString(), QUACKLE_LEXICON_PARAMETERS->gaddagRoot());
+			hookScoreBefore[i + 1] += (perpendicular + tileScore * letterMultipliers[i]) * wordMultipliers[i];
+		}
+	}
 
+	for (int laid = 0; laid <= m_rackScoreCount; laid++)
+		m_laidBounds[laid] = -1e9;
+	m_boundLaidMax = 0;
+
+	if (!usable[anchor])
+		return -1e9;
+
+	// Every play through the anchor covers a contiguous run of squares
+	// within the left limit, and can't cross an unusable square.
+	const int leftmost = max(anchor - board().gaddagAnchorLimit(row, col, horizontal), 0);
+	const int anchorEmpties = filled[anchor]? 0 : 1;
+
+	int leftEmpties[QUACKLE_MAXIMUM_BOARD_SIZE];
+	int leftCount = 0;
+	int first = anchor;
+	while (first > leftmost && usable[first - 1] && leftCount + anchorEmpties < m_rackScoreCount) {
+		first--;
+		if (!filled[first])
+			leftEmpties[leftCount++] = first;
+	}
+
+	int rightEmpties[QUACKLE_MAXIMUM_BOARD_SIZE];
+	int rightCount = 0;
+	int last = anchor;
+	while (last + 1 < lineLength && usable[last + 1] && (filled[last + 1] || rightCount + anchorEmpties < m_rackScoreCount)) {
+		last++;
+		if (!filled[last])
+			rightEmpties[rightCount++] = last;
+	}
+
+	// Bound each choice of how many empty squares to cover on either
+	// side. Laying more tiles scores more but keeps a worse leave, so
+	// the bound for each tile count is kept separately.
+	double bound = -1e9;
+	for (int left = 0; left <= leftCount; left++) {
+		int start = left == 0? anchor : leftEmpties[left - 1];
+		while (start > 0 && filled[start - 1])
+			start--;
+
+		for (int right = 0; right <= rightCount; right++) {
+			const int laid = left + right + anchorEmpties;
+			if (laid == 0)
+				continue;
+			if (laid > m_rackScoreCount)
+				break;
+
+			int end = right == 0? anchor : rightEmpties[right - 1];
+			while (end + 1 < lineLength && filled[end + 1])
+				end++;
+
+			// pair our best tiles with the best letter premiums covered
+			int premiums[QUACKLE_MAXIMUM_BOARD_SIZE];
+			int premiumCount = 0;
+			int wordMultiplier = 1;
+			for (int i = start; i <= end; i++) {
+				if (filled[i])
+					continue;
+
+				int j = premiumCount++;
+				while (j > 0 && premiums[j - 1] < letterMultipliers[i]) {
+					premiums[j] = premiums[j - 1];
+					j--;
+				}
+				premiums[j] = letterMultipliers[i];
+				wordMultiplier *= wordMultipliers[i];
 			}
+
+			int mainScore = playedThruBefore[end + 1] - playedThruBefore[start];
+			for (int i = 0; i < laid; i++)
+				mainScore += m_rackScores[i] * premiums[i];
+
+			double laidBound = mainScore * wordMultiplier + hookScoreBefore[end + 1] - hookScoreBefore[start] + m_bestRackEquity[laid];
+			if (laid == QUACKLE_PARAMETERS->rackSize())
+				laidBound += QUACKLE_PARAMETERS->bingoBonus();
+
+			m_laidBounds[laid] = max(m_laidBounds[laid], laidBound);
+			m_boundLaidMax = max(m_boundLaidMax, laid);
+			bound = max(bound, laidBound);
 		}
 	}
 
-	return best;
+	// remember the window so gordongen can keep pruning as tiles go down
+	m_boundFirst = first;
+	m_boundLast = last;
+	m_boundEmptiesBefore[first] = 0;
+	for (int i = first; i <= last; i++)
+		m_boundEmptiesBefore[i + 1] = m_boundEmptiesBefore[i] + (filled[i]? 0 : 1);
+
+	return bound;
+}
+
+bool Generator::cannotBeatBest(int pos)
+{
+	// how many more tiles could still go down: to our left and past the
+	// anchor while still extending leftward, or to our right afterward
+	const int anchor = m_gordonhoriz? m_anchorcol : m_anchorrow;
+	const int current = anchor + pos;
+	int room;
+	if (pos <= 0) {
+		room = current < m_boundFirst? 0 : m_boundEmptiesBefore[current + 1];
+		room += m_boundEmptiesBefore[m_boundLast + 1] - m_boundEmptiesBefore[anchor + 1];
+	}
+	else {
+		room = current > m_boundLast? 0 : m_boundEmptiesBefore[m_boundLast + 1] - m_boundEmptiesBefore[current];
+	}
+
+	const int most = min(m_boundLaidMax, m_laid + room);
+	for (int laid = max(m_laid, 1); laid <= most; laid++)
+		if (m_laidBounds[laid] >= best.equity - 1e-6)
+			return false;
+
+	return true;
 }
 
 void Generator::spit(int i, const LetterString &prefix, int flags)
@@ -1600,13 +1778,20 @@ void Generator::wordspit(int i, const LetterString &prefix, int flags)
 
 Move Generator::exchange()
 {
-	map<LetterString, bool> throwmap;
+	// throwing the same letters from different places on the rack
+	// leaves the same key
+	vector<bool> thrownKeys(m_leaveValues.size(), false);
 
 	const int rackSize = rack().tiles().length();
 	const int permutations = 1 << rackSize;
 	
 	for (int i = 1; i < permutations; i++)
 	{
+		const int leaveKey = m_usedTileLeaveKeys[i];
+		if (thrownKeys[leaveKey])
+			continue;
+		thrownKeys[leaveKey] = true;
+
 		LetterString thrown;
 		for (int j = 0; j < rackSize; j++)
 			if (i & (1 << j))
@@ -1616,29 +1801,20 @@ Move Generator::exchange()
 		move.action = Move::Exchange;
 		move.setTiles(String::alphabetize(thrown));
 		move.score = 0;
-		move.equity = equity(move);
-
-		if (throwmap.find(move.tiles()) == throwmap.end())
-		{
-			if (m_recordall)
-				m_moveList.push_back(move);
-
-			if (MoveList::equityComparator(best, move)) 
-				best = move;
-
-			throwmap[move.tiles()] = true;
-		}
+		foundPlay(move, leaveKey);
 	}
 
+	recordPendingPlays();
 	return best;
 }
 
 Move Generator::findstaticbest(bool canExchange)
 {
 	best = Move::createPassMove();
-	m_moveList.clear();
+	m_recordedMoves = 0;
 
 	setupCounts(rack().tiles());
+	prepareLeaves();
 
 	if (QUACKLE_LEXICON_PARAMETERS->hasSomething())
 	{
@@ -1665,8 +1841,8 @@ Move Generator::findstaticbest(bool canExchange)
 	if (canExchange)
 		exchange();
 
-	if (m_moveList.empty())
-		m_moveList.push_back(best);
+	if (m_recordedMoves == 0)
+		recordMove(best);
 
 	return best;
 }
@@ -1786,6 +1962,11 @@ Move Generator::anagram()
 	WordList::const_iterator end = m_spat.end();
 	for (WordList::const_iterator it = m_spat.begin(); it != end; ++it)
 	{
+		// every tile of an opening play comes from the rack
+		int leaveKey = m_leaveKey;
+		for (unsigned int k = 0; k < (*it).length(); k++)
+			leaveKey -= m_leaveStrides[QUACKLE_ALPHABET_PARAMETERS->isBlankLetter((*it)[k])? QUACKLE_BLANK_MARK : (*it)[k]];
+
 		for (unsigned int k = 0; k < (*it).length(); k++)
 		{
 			Move move;
@@ -1799,18 +1980,11 @@ Move Generator::anagram()
 				continue;
 
 			move.score = board().score(move, &move.isBingo);
-
-			move.equity = equity(move);
-			// UVcout << move << " has equity " << move.equity << endl;
-
-			if (m_recordall)
-				m_moveList.push_back(move);
-
-			if (MoveList::equityComparator(best, move)) 
-				best = move;
+			foundPlay(move, leaveKey);
 		}
 	}
 
+	recordPendingPlays();
 	return best;
 }
 
@@ -24,6 +24,7 @@
 #include "alphabetparameters.h"
 #include "game.h"
 #include "move.h"
+#include "movesink.h"
 
 using std::vector;
 
@@ -31,6 +32,7 @@ namespace Quackle
 {
 
 class GaddagNode;
+class IndexedGaddagNode;
 
 class ExtensionWithInfo
 {
@@ -66,26 +68,58 @@ public:
 	Generator(const Quackle::GamePosition &position);
 	~Generator();
 
-	enum KibitzFlags { RegularKibitz = 0x0000, CannotExchange = 0x0001 /*, OtherOption = 0x0002, OtherOption2 = 0x0004 */ };
+	enum KibitzFlags { RegularKibitz = 0x0000, CannotExchange = 0x0001, PruneToBest = 0x0002 /*, OtherOption2 = 0x0004 */ };
 
 	// kibitzLength = 1 means kibitz list is of length one, and contains
-	// only the best move, and allPossiblePlays() is invalid.
+	// only the best move, as does allPossiblePlays().
 	// kibitzLength <= 1 interpreted as kibitz length of 1
+	// Only the best kibitzLength plays are kept as they are found;
+	// allPossiblePlays() generates again to list the rest.
+	// With PruneToBest and a kibitz length of one, anchors whose
+	// optimistic equity can't beat the best move found so far are
+	// skipped. This assumes the evaluator's equity is the score plus
+	// something that depends only on the tiles used, as is true of
+	// the stock evaluators on a nonempty board.
 	void kibitz(int kibitzLength = 10, int flags = AnagramRearrange);
 
 	const MoveList &kibitzList();
 	const MoveList &allPossiblePlays();
 
+	// Hand every play on the position to sink, in the order they're
+	// found, instead of keeping them; sink decides what's worth making
+	// into a Move. As with kibitz, the best move (a pass if nothing
+	// else) goes to sink when there are no other plays. flags are
+	// KibitzFlags, though PruneToBest is ignored. Leaves kibitzList()
+	// and allPossiblePlays() empty.
+	void generateInto(MoveSink &sink, int flags = RegularKibitz);
+
 	// set generator to generate on this position
 	// (using current player's rack)
 	void setPosition(const GamePosition &position);
 	const GamePosition &position() const;
 
+	// The position may be changed in place between generations;
+	// makeMove keeps its board and crosses up to date.
+	GamePosition &position();
+
 	// place a move on the board; if regenerateCrosses is false,
 	// you'll need to call allCrosses if you want to make more plays
 	// on the board
 	void makeMove(const Move &move, bool regenerateCrosses);
 
+	// if true (the default), makeMove only recomputes the crosses of
+	// squares on lines touched by the move; otherwise it rebuilds
+	// every cross on the board with allCrosses
+	void setIncrementalCrosses(bool incremental);
+	bool incrementalCrosses() const;
+
+	// Number of threads kibitz may split the anchors across when it
+	// records every play; each thread gets its own copy of the
+	// generator. The move list comes out exactly as it would from one
+	// thread, which is the default.
+	void setThreadCount(int count);
+	int threadCount() const;
+
 	enum AnagramFlags { AnagramRearrange	= 0x0000, 
 			    NoRequireAllLetters	= 0x0001, 
 			    AddAnyLetters	= 0x0002, 
@@ -108,6 +142,28 @@ private:
 	// passes on to the global evaluator
 	double equity(const Move &move) const;
 
+	// as equity, for a play from the rack leaving the tiles whose
+	// leave key is leaveKey
+	double equity(const Move &move, int leaveKey) const;
+
+	// Take move, a play from the rack leaving the tiles whose leave key
+	// is leaveKey. If all plays are being recorded it waits to be valued
+	// along with the rest of its anchor's by recordPendingPlays;
+	// otherwise it's valued now and becomes best if it beats it.
+	void foundPlay(Move &move, int leaveKey);
+
+	// value the plays waiting since the last call in one go, record
+	// them in the order found and update best
+	void recordPendingPlays();
+
+	// set up the leave key and leave values of the rack; the
+	// evaluator values each distinct leave once
+	void prepareLeaves();
+
+	// hand a play to m_moveSink
+	void recordMove(const Move &move);
+	void recordMove(const PackedMove &move);
+
 	// i'll make these private very soon
 	// no you won't, olaugh :)
 	Move generate();
@@ -119,6 +175,32 @@ private:
 	Move exchange();
 	Move findstaticbest(bool canExchange);
 
+	// set up the rack-dependent terms of anchorEquityBound
+	void prepareEquityBounds();
+
+	// an upper bound on the equity of any play through this anchor;
+	// also sets up cannotBeatBest for the anchor
+	double anchorEquityBound(int row, int col, bool horizontal);
+
+	// whether no play continuing from here can beat best
+	bool cannotBeatBest(int pos);
+
+	struct Anchor
+	{
+		int row, col;
+		bool horizontal;
+	};
+
+	// generate every play through each anchor in turn, with the gaddag
+	// or the dawg, on m_threadCount threads if it's worth it
+	void generateAnchors(const vector<Anchor> &anchors, bool gaddag);
+
+	// generate every play through one gaddag anchor
+	void gordonAnchor(int row, int col, bool horizontal);
+
+	// generate every play starting from one dawg anchor
+	void dawgAnchor(int row, int col, bool horizontal);
+
 	void setupCounts(const LetterString &letters);
 
 	// returned letter is a fancy letter
@@ -134,12 +216,21 @@ private:
 	void spit(int i, const LetterString &prefix, int flags);
 	void wordspit(int i, const LetterString &prefix, int flags);
 
-	LetterBitset gaddagFitbetween(const LetterString &pre, const LetterString &suf);
+	// the gaddag walks take either a GaddagNode or, when the lexicon has
+	// one, an IndexedGaddagNode
+	template <class Node> LetterBitset gaddagFitbetween(const Node *root, const LetterString &pre, const LetterString &suf);
 	void gaddagAnagram(const GaddagNode *node, const LetterString &prefix, int flags);
-	void gordongen(int pos, const LetterString &word, const GaddagNode *node);
-	void gordongoon(int pos, char L, LetterString word, const GaddagNode *node);
+	template <class Node> void gordongen(int pos, const LetterString &word, const Node *node);
+	template <class Node> void gordongoon(int pos, char L, LetterString word, const Node *node);
+
+	// lay each rack tile that fits the cross and the node's children
+	// at pos and carry on with gordongoon
+	void gordonTiles(int pos, const LetterString &word, const GaddagNode *node, const LetterBitset &cross);
+	void gordonTiles(int pos, const LetterString &word, const IndexedGaddagNode *node, const LetterBitset &cross);
 
-	void filterOutDuplicatePlays();
+	// recompute the cross of one square from the tiles around it
+	void updateVCross(int row, int col);
+	void updateHCross(int row, int col);
 
 	// debug stuff
 	UVString counts2string();
@@ -147,9 +238,17 @@ private:
 
 	Move best;
 
-	// keeps *all* moves
+	// keeps *all* moves, found again for allPossiblePlays() after a
+	// kibitz, which keeps only the best
 	MoveList m_moveList;
 
+	// where plays go as they're found
+	MoveSink *m_moveSink;
+	size_t m_recordedMoves;
+
+	bool m_moveListStale;
+	int m_kibitzFlags;
+
 	// sorts and prunes into kibitzed list
 	MoveList m_kibitzList;
 
@@ -157,6 +256,23 @@ private:
 
 	char m_counts[QUACKLE_FIRST_LETTER + QUACKLE_MAXIMUM_ALPHABET_SIZE];
 	int m_laid;
+
+	// The leave key of what's left of the rack, kept up to date with
+	// m_counts as tiles are laid: the sum over the rack's letters of how
+	// many are left times the letter's stride. Each stride is the
+	// product of one more than the rack count of each letter before it
+	// on the rack, and is zero for letters not on the rack.
+	// m_leaveValues has the evaluator's leaveValue of each key's leave,
+	// and m_usedTileLeaveKeys the key left by laying each subset of
+	// the rack's tiles, bit i standing for rack().tiles()[i].
+	int m_leaveKey;
+	int m_leaveStrides[QUACKLE_FIRST_LETTER + QUACKLE_MAXIMUM_ALPHABET_SIZE];
+	vector<double> m_leaveValues;
+	vector<int> m_usedTileLeaveKeys;
+
+	// plays found and not yet valued, and the values of their leaves
+	vector<PackedMove> m_pendingPlays;
+	vector<double> m_pendingLeaveValues;
 	int m_leftlimit;
 
 	WordList m_spat;
@@ -164,7 +280,30 @@ private:
 
 	bool m_recordall;
 	bool m_gordonhoriz;
+	bool m_incrementalCrosses;
+	bool m_pruneToBest;
+	int m_threadCount;
 	int m_anchorrow, m_anchorcol;
+
+	// rack tile scores, highest first, and the letters on the rack,
+	// for anchorEquityBound
+	int m_rackScores[QUACKLE_MAXIMUM_BOARD_SIZE];
+	int m_rackScoreCount;
+	LetterBitset m_rackLetters;
+	bool m_rackHasBlank;
+
+	// IndexedGaddagNode::letterBit()s of the letters m_counts has left
+	uint64_t m_rackLetterBits;
+
+	// best non-score equity of a play using a given number of tiles
+	double m_bestRackEquity[QUACKLE_MAXIMUM_BOARD_SIZE + 1];
+
+	// for the current anchor: equity bound by number of tiles laid, and
+	// the window of squares plays can cover with its empty-square counts
+	double m_laidBounds[QUACKLE_MAXIMUM_BOARD_SIZE + 1];
+	int m_boundLaidMax;
+	int m_boundFirst, m_boundLast;
+	int m_boundEmptiesBefore[QUACKLE_MAXIMUM_BOARD_SIZE + 1];
 };
 
 
@@ -178,6 +317,31 @@ inline const GamePosition &Generator::position() const
 	return m_position;
 }
 
+inline GamePosition &Generator::position()
+{
+	return m_position;
+}
+
+inline void Generator::setIncrementalCrosses(bool incremental)
+{
+	m_incrementalCrosses = incremental;
+}
+
+inline bool Generator::incrementalCrosses() const
+{
+	return m_incrementalCrosses;
+}
+
+inline void Generator::setThreadCount(int count)
+{
+	m_threadCount = count;
+}
+
+inline int Generator::threadCount() const
+{
+	return m_threadCount;
+}
+
 inline Board &Generator::board()
 {
 	return m_position.underlyingBoardReference();
@@ -193,14 +357,20 @@ inline void Generator::setrecordall(bool b)
 	m_recordall = b;
 }
 
-inline const MoveList &Generator::kibitzList()
+inline void Generator::recordMove(const Move &move)
 {
-	return m_kibitzList;
+	recordMove(PackedMove(move));
 }
 
-inline const MoveList &Generator::allPossiblePlays()
+inline void Generator::recordMove(const PackedMove &move)
 {
-	return m_moveList;
+	m_moveSink->consume(move);
+	++m_recordedMoves;
+}
+
+inline const MoveList &Generator::kibitzList()
+{
+	return m_kibitzList;
 }
 
 }
@@ -17,9 +17,18 @@
  */
 
 #include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "datamanager.h"
 #include "lexiconparameters.h"
 #include "uv.h"
@@ -45,6 +54,19 @@ class Quackle::V0LexiconInterpreter : public LexiconInterpreter {
     }
   }
 
+  // v0 files have no header
+  virtual bool mapDawg(const unsigned char *, size_t, LexiconParameters &,
+                       size_t &offset) {
+    offset = 0;
+    return true;
+  }
+
+  virtual bool mapGaddag(const unsigned char *, size_t, LexiconParameters &,
+                         size_t &offset) {
+    offset = 0;
+    return true;
+  }
+
   virtual void dawgAt(const unsigned char *dawg, int index, unsigned int &p,
                       Letter &letter, bool &t, bool &lastchild, bool &british,
                       int &playability) const {
@@ -104,6 +126,46 @@ class Quackle::V1LexiconInterpreter : public LexiconInterpreter {
     }
   }
 
+  // the same headers as loadDawg and loadGaddag read, parsed in place
+  virtual bool mapDawg(const unsigned char *data, size_t length,
+                       LexiconParameters &lexparams, size_t &offset) {
+    size_t i = 1 + sizeof(lexparams.m_hash) + 3;
+    if (length <= i)
+      return false;
+    memcpy(lexparams.m_hash, data + 1, sizeof(lexparams.m_hash));
+
+    lexparams.m_utf8Alphabet.resize(data[i++]);
+    for (size_t j = 0; j < lexparams.m_utf8Alphabet.size(); j++) {
+      while (i < length && isspace(data[i]))
+        i++;
+      const size_t start = i;
+      while (i < length && !isspace(data[i]))
+        i++;
+      lexparams.m_utf8Alphabet[j].assign((const char *)data + start, i - start);
+      i++; // separator space
+    }
+    if (i > length)
+      return false;
+
+    offset = i;
+    return true;
+  }
+
+  virtual bool mapGaddag(const unsigned char *data, size_t length,
+                         LexiconParameters &lexparams, size_t &offset) {
+    const size_t headerLength = 1 + sizeof(lexparams.m_hash);
+    if (length < headerLength)
+      return false;
+    if (memcmp(data + 1, lexparams.m_hash, sizeof(lexparams.m_hash))) {
+      // If we're using a v0 DAWG, then ignore the hash
+      if (lexparams.m_hash[0] != 0)
+        return false; // don't use a mismatched gaddag
+    }
+
+    offset = headerLength;
+    return true;
+  }
+
   virtual void dawgAt(const unsigned char *dawg, int index, unsigned int &p,
                       Letter &letter, bool &t, bool &lastchild, bool &british,
                       int &playability) const {
@@ -122,8 +184,44 @@ class Quackle::V1LexiconInterpreter : public LexiconInterpreter {
   virtual int versionNumber() const { return 1; }
 };
 
+// Maps a whole file read-only; false where that isn't possible, in which
+// case the caller reads the file instead.
+static bool mapLexiconFile(const string &filename, const unsigned char *&data,
+                           size_t &length) {
+#if defined(_WIN32)
+  return false;
+#else
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+    close(fd);
+    return false;
+  }
+
+  void *mapping =
+      mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return false;
+
+  data = (const unsigned char *)mapping;
+  length = info.st_size;
+  return true;
+#endif
+}
+
+static void unmapLexiconFile(const unsigned char *data, size_t length) {
+#if !defined(_WIN32)
+  munmap((void *)data, length);
+#endif
+}
+
 LexiconParameters::LexiconParameters()
-    : m_dawg(NULL), m_gaddag(NULL), m_interpreter(NULL) {
+    : m_dawg(NULL), m_gaddag(NULL), m_gaddagSize(0), m_memoryMapped(false),
+      m_indexGaddag(false), m_interpreter(NULL) {
   memset(m_hash, 0, sizeof(m_hash));
 }
 
@@ -135,15 +233,73 @@ void LexiconParameters::unloadAll() {
 }
 
 void LexiconParameters::unloadDawg() {
-  delete[] m_dawg;
+  if (m_dawgMapping.data) {
+    unmapLexiconFile(m_dawgMapping.data, m_dawgMapping.length);
+    m_dawgMapping = FileMapping();
+  } else {
+    delete[] m_dawg;
+  }
   m_dawg = NULL;
   delete m_interpreter;
   m_interpreter = NULL;
 }
 
 void LexiconParameters::unloadGaddag() {
-  delete[] m_gaddag;
+  if (m_gaddagMapping.data) {
+    unmapLexiconFile(m_gaddagMapping.data, m_gaddagMapping.length);
+    m_gaddagMapping = FileMapping();
+  } else {
+    delete[] m_gaddag;
+  }
   m_gaddag = NULL;
+  m_gaddagSize = 0;
+  vector<IndexedGaddagNode>().swap(m_indexedGaddag);
+}
+
+void LexiconParameters::setIndexGaddag(bool indexGaddag) {
+  m_indexGaddag = indexGaddag;
+  if (!m_indexGaddag)
+    vector<IndexedGaddagNode>().swap(m_indexedGaddag);
+  else if (hasGaddag() && !hasIndexedGaddag())
+    buildIndexedGaddag();
+}
+
+// Copies every node reachable from the root into the same index of
+// m_indexedGaddag, so child offsets carry over unchanged and only the
+// child letter masks need computing. The tail of m_gaddag past the
+// last node is never read.
+void LexiconParameters::buildIndexedGaddag() {
+  const size_t nodeCount = m_gaddagSize / 4;
+  const GaddagNode *nodes = gaddagRoot();
+
+  m_indexedGaddag.assign(nodeCount, IndexedGaddagNode());
+  vector<bool> visited(nodeCount, false);
+  vector<size_t> pending(1, 0);
+
+  while (!pending.empty()) {
+    const size_t index = pending.back();
+    pending.pop_back();
+    if (visited[index])
+      continue;
+    visited[index] = true;
+
+    const GaddagNode &node = nodes[index];
+    IndexedGaddagNode &indexed = m_indexedGaddag[index];
+    indexed.m_letter = node.letter();
+    indexed.m_flags = (node.isTerminal() ? 0x40 : 0) |
+                      (node.nextSibling() == 0 ? 0x80 : 0);
+    indexed.m_childLetters = 0;
+    indexed.m_firstChild = 0;
+
+    const GaddagNode *first = node.firstChild();
+    if (first == 0)
+      continue;
+    indexed.m_firstChild = first - &node;
+    for (const GaddagNode *child = first; child; child = child->nextSibling()) {
+      indexed.m_childLetters |= IndexedGaddagNode::letterBit(child->letter());
+      pending.push_back(child - nodes);
+    }
+  }
 }
 
 #include <filesystem>
@@ -187,6 +343,19 @@ void LexiconParameters::loadDawg(const string &filename) {
     return;
   }
 
+  if (m_memoryMapped && mapLexiconFile(filename, m_dawgMapping.data,
+                                       m_dawgMapping.length)) {
+    size_t offset;
+    if (m_interpreter->mapDawg(m_dawgMapping.data, m_dawgMapping.length, *this,
+                               offset)) {
+      m_dawg = m_dawgMapping.data + offset;
+    } else {
+      UVcout << "Couldn't open file " << filename.c_str() << endl;
+      unloadDawg();
+    }
+    return;
+  }
+
   file.seekg(0, ios_base::end);
   m_dawg = new unsigned char[file.tellg()];
   file.seekg(0, ios_base::beg);
@@ -207,8 +376,27 @@ void LexiconParameters::loadGaddag(const string &filename) {
   char versionByte = file.get();
   if (versionByte < m_interpreter->versionNumber())
     return;
+
+  if (m_memoryMapped && mapLexiconFile(filename, m_gaddagMapping.data,
+                                       m_gaddagMapping.length)) {
+    LexiconInterpreter *interpreter = createInterpreter(versionByte);
+    size_t offset;
+    if (interpreter != NULL &&
+        interpreter->mapGaddag(m_gaddagMapping.data, m_gaddagMapping.length,
+                               *this, offset)) {
+      m_gaddag = m_gaddagMapping.data + offset;
+      m_gaddagSize = m_gaddagMapping.length - offset;
+      if (m_indexGaddag)
+        buildIndexedGaddag();
+    } else
+      unloadGaddag();
+    delete interpreter;
+    return;
+  }
+
   file.seekg(0, ios_base::end);
-  m_gaddag = new unsigned char[file.tellg()];
+  m_gaddagSize = file.tellg();
+  m_gaddag = new unsigned char[m_gaddagSize];
   file.seekg(0, ios_base::beg);
 
   // must create a local interpreter because dawg/gaddag versions might not
@@ -217,6 +405,8 @@ void LexiconParameters::loadGaddag(const string &filename) {
   if (interpreter != NULL) {
     interpreter->loadGaddag(file, *this);
     delete interpreter;
+    if (m_indexGaddag && hasGaddag())
+      buildIndexedGaddag();
   } else
     unloadGaddag();
 }
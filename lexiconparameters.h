@@ -35,6 +35,11 @@ class LexiconInterpreter
 public:
 	virtual void loadDawg(std::ifstream &file, LexiconParameters &lexparams) = 0;
 	virtual void loadGaddag(std::ifstream &file, LexiconParameters &lexparams) = 0;
+
+	// parse the header of a whole file mapped at data, setting offset to
+	// where its nodes start; false if the file is unusable
+	virtual bool mapDawg(const unsigned char *data, size_t length, LexiconParameters &lexparams, size_t &offset) = 0;
+	virtual bool mapGaddag(const unsigned char *data, size_t length, LexiconParameters &lexparams, size_t &offset) = 0;
 	virtual void dawgAt(const unsigned char *dawg, int index, unsigned int &p, Letter &letter, bool &t, bool &lastchild, bool &british, int &playability) const = 0;
 	virtual int versionNumber() const = 0;
 	virtual ~LexiconInterpreter() {};
@@ -54,6 +59,13 @@ public:
 
 	void unloadAll();
 
+	// When set, loadDawg and loadGaddag map their files read-only and
+	// use the nodes in place rather than reading them onto the heap, so
+	// processes using the same lexicon share its pages. Loading falls
+	// back to reading where the file can't be mapped.
+	void setMemoryMapped(bool memoryMapped) { m_memoryMapped = memoryMapped; };
+	bool memoryMapped() const { return m_memoryMapped; };
+
 	// true if we have a dawg or a gaddag
 	bool hasSomething() const { return hasDawg() || hasGaddag(); };
 
@@ -68,6 +80,14 @@ public:
 	void unloadGaddag();
 	bool hasGaddag() const { return m_gaddag != NULL; };
 
+	// When set, loadGaddag also builds an IndexedGaddagNode copy of the
+	// gaddag, which move generation then prefers. It takes four times
+	// the memory of the gaddag itself. Setting it with a gaddag already
+	// loaded builds or drops the copy right away.
+	void setIndexGaddag(bool indexGaddag);
+	bool indexGaddag() const { return m_indexGaddag; };
+	bool hasIndexedGaddag() const { return !m_indexedGaddag.empty(); };
+
 	// finds a file in the lexica data directory
 	static string findDictionaryFile(const string &lexicon);
 	static bool hasUserDictionaryFile(const string &lexicon);
@@ -81,6 +101,7 @@ public:
 		m_interpreter->dawgAt(m_dawg, index, p, letter, t, lastchild, british, playability);
 	}
 	const GaddagNode *gaddagRoot() const { return (GaddagNode *) &m_gaddag[0]; };
+	const IndexedGaddagNode *indexedGaddagRoot() const { return &m_indexedGaddag[0]; };
 
 	string hashString(bool shortened) const;
 	string copyrightString() const;
@@ -88,8 +109,22 @@ public:
 	const vector<string> &utf8Alphabet() const { return m_utf8Alphabet; };
 
 protected:
-	unsigned char *m_dawg;
-	unsigned char *m_gaddag;
+	// a read-only mapping of a whole lexicon file
+	struct FileMapping
+	{
+		FileMapping() : data(NULL), length(0) {}
+		const unsigned char *data;
+		size_t length;
+	};
+
+	const unsigned char *m_dawg;
+	const unsigned char *m_gaddag;
+	size_t m_gaddagSize;
+	bool m_memoryMapped;
+	FileMapping m_dawgMapping;
+	FileMapping m_gaddagMapping;
+	bool m_indexGaddag;
+	vector<IndexedGaddagNode> m_indexedGaddag;
 	string m_lexiconName;
 	LexiconInterpreter *m_interpreter;
 	char m_hash[16];
@@ -99,6 +134,7 @@ protected:
 
 private:
 	string getLexiconCopyrightLine() const;
+	void buildIndexedGaddag();
 };
 
 }
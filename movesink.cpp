@@ -0,0 +1,195 @@
+/*
+ *  Quackle -- Crossword game artificial intelligence and analysis tool
+ *  Copyright (C) 2005-2019 Jason Katz-Brown, John O'Laughlin, and John Fultz.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cassert>
+
+#include "board.h"
+#include "movesink.h"
+
+using namespace Quackle;
+using namespace std;
+
+PackedMove::PackedMove(const Move &move)
+	: equity(move.equity), score(move.score), action(move.action), startrow(move.startrow), startcol(move.startcol), horizontal(move.horizontal), isBingo(move.isBingo), length(move.tiles().length())
+{
+	copy(move.tiles().begin(), move.tiles().end(), tiles);
+}
+
+Move PackedMove::toMove() const
+{
+	Move move;
+	move.action = (Move::Action) action;
+	move.horizontal = horizontal;
+	move.startrow = startrow;
+	move.startcol = startcol;
+	move.setTiles(LetterString((const char *) tiles, length));
+	move.score = score;
+	move.isBingo = isBingo;
+	move.equity = equity;
+	return move;
+}
+
+bool PackedMove::equityComparator(const PackedMove &move1, const PackedMove &move2)
+{
+	if (move1.equity != move2.equity)
+		return move1.equity < move2.equity;
+
+	// as MoveList::wordPosComparator
+	if (move1.startrow != move2.startrow)
+		return move1.startrow < move2.startrow;
+
+	if (move1.startcol != move2.startcol)
+		return move1.startcol < move2.startcol;
+
+	if (move1.horizontal != move2.horizontal)
+		return move1.horizontal < move2.horizontal;
+
+	if (move1.score != move2.score)
+		return move1.score < move2.score;
+
+	// LetterString compares chars
+	const int length = min(move1.length, move2.length);
+	for (int i = 0; i < length; ++i)
+		if (move1.tiles[i] != move2.tiles[i])
+			return (char) move1.tiles[i] < (char) move2.tiles[i];
+
+	assert(move1.length != move2.length);
+	return move1.length < move2.length;
+}
+
+// entries that compare equal are told apart by the order they were
+// found in, later being better; heaps under this keep the worst entry
+// at the front
+bool TopMovesSink::better(const Entry &entry1, const Entry &entry2)
+{
+	if (PackedMove::equityComparator(entry2.move, entry1.move))
+		return true;
+	if (PackedMove::equityComparator(entry1.move, entry2.move))
+		return false;
+	return entry1.found > entry2.found;
+}
+
+TopMovesSink::TopMovesSink(size_t maximumSize)
+	: m_maximumSize(maximumSize), m_found(0)
+{
+}
+
+void TopMovesSink::consume(const PackedMove &move)
+{
+	Entry entry;
+	entry.move = move;
+	entry.found = m_found++;
+
+	if (m_heap.size() < m_maximumSize)
+	{
+		m_heap.push_back(entry);
+		push_heap(m_heap.begin(), m_heap.end(), better);
+	}
+	else if (m_maximumSize > 0 && better(entry, m_heap.front()))
+	{
+		pop_heap(m_heap.begin(), m_heap.end(), better);
+		m_heap.back() = entry;
+		push_heap(m_heap.begin(), m_heap.end(), better);
+	}
+}
+
+void TopMovesSink::clear()
+{
+	m_heap.clear();
+	m_found = 0;
+}
+
+MoveList TopMovesSink::moves() const
+{
+	vector<Entry> sorted(m_heap);
+	sort(sorted.begin(), sorted.end(), better);
+
+	MoveList ret;
+	ret.reserve(sorted.size());
+	for (vector<Entry>::const_iterator it = sorted.begin(); it != sorted.end(); ++it)
+		ret.push_back(it->move.toMove());
+	return ret;
+}
+
+DistinctMovesSink::DistinctMovesSink(MoveSink &sink)
+	: m_sink(sink), m_keys(256, -1), m_keyCount(0)
+{
+}
+
+void DistinctMovesSink::consume(const PackedMove &move)
+{
+	int usedTileCount = 0;
+	int actualTileIndex = -1;
+	for (int i = 0; i < move.length; ++i)
+	{
+		if (move.tiles[i] != QUACKLE_PLAYED_THRU_MARK)
+		{
+			++usedTileCount;
+			if (actualTileIndex < 0)
+				actualTileIndex = i;
+		}
+	}
+
+	if (usedTileCount == 1)
+	{
+		const int row = move.startrow + (move.horizontal? 0 : actualTileIndex);
+		const int column = move.startcol + (move.horizontal? actualTileIndex : 0);
+		const int key = row + QUACKLE_MAXIMUM_BOARD_SIZE * column + (QUACKLE_MAXIMUM_BOARD_SIZE * QUACKLE_MAXIMUM_BOARD_SIZE) * move.tiles[actualTileIndex];
+
+		if (!insert(key))
+			return;
+	}
+
+	m_sink.consume(move);
+}
+
+void DistinctMovesSink::clear()
+{
+	fill(m_keys.begin(), m_keys.end(), -1);
+	m_keyCount = 0;
+}
+
+bool DistinctMovesSink::insert(int key)
+{
+	const size_t mask = m_keys.size() - 1;
+	size_t slot = (key * 2654435761u) & mask;
+	for (; m_keys[slot] >= 0; slot = (slot + 1) & mask)
+		if (m_keys[slot] == key)
+			return false;
+
+	m_keys[slot] = key;
+
+	// stay at most half full
+	if (++m_keyCount * 2 > m_keys.size())
+	{
+		vector<int> keys(m_keys.size() * 2, -1);
+		keys.swap(m_keys);
+		m_keyCount = 0;
+		for (vector<int>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+			if (*it >= 0)
+				insert(*it);
+	}
+
+	return true;
+}
+
+CallbackMoveSink::CallbackMoveSink(const function<void(const PackedMove &)> &callback)
+	: m_callback(callback)
+{
+}
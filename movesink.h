@@ -0,0 +1,174 @@
+/*
+ *  Quackle -- Crossword game artificial intelligence and analysis tool
+ *  Copyright (C) 2005-2019 Jason Katz-Brown, John O'Laughlin, and John Fultz.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QUACKLE_MOVESINK_H
+#define QUACKLE_MOVESINK_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "move.h"
+
+namespace Quackle
+{
+
+// A play as the generator finds it, before it's made into a Move.
+// Unlike Move it has no strings with pointers into themselves, so it
+// is small and cheap to copy, sort and throw away.
+class PackedMove
+{
+public:
+	PackedMove() = default;
+	explicit PackedMove(const Move &move);
+
+	Move toMove() const;
+
+	// the order MoveList::equityComparator gives the Moves
+	static bool equityComparator(const PackedMove &move1, const PackedMove &move2);
+
+	double equity;
+	std::int32_t score;
+	unsigned char action; // a Move::Action
+	unsigned char startrow;
+	unsigned char startcol;
+	bool horizontal;
+	bool isBingo;
+
+	// like Move::tiles()
+	unsigned char length;
+	Letter tiles[FIXED_STRING_MAXIMUM_LENGTH];
+};
+
+// Where Generator::generateInto puts the plays it finds.
+class MoveSink
+{
+public:
+	virtual ~MoveSink() {}
+	virtual void consume(const PackedMove &move) = 0;
+};
+
+// keeps every play in the order found
+class AllMovesSink : public MoveSink
+{
+public:
+	virtual void consume(const PackedMove &move);
+
+	void clear();
+	const std::vector<PackedMove> &moves() const;
+	std::vector<PackedMove> &moves();
+
+private:
+	std::vector<PackedMove> m_moves;
+};
+
+// keeps the best maximumSize plays
+class TopMovesSink : public MoveSink
+{
+public:
+	TopMovesSink(size_t maximumSize);
+
+	virtual void consume(const PackedMove &move);
+
+	void clear();
+
+	// The plays kept, best first, as MoveList::sort(list, Equity) would
+	// order the list of all of them; that sort is stable and then
+	// reversed, so of plays that compare equal the last found is first.
+	MoveList moves() const;
+
+private:
+	struct Entry
+	{
+		PackedMove move;
+		size_t found;
+	};
+
+	static bool better(const Entry &entry1, const Entry &entry2);
+
+	size_t m_maximumSize;
+	size_t m_found;
+
+	// a heap with the worst play kept at the front
+	std::vector<Entry> m_heap;
+};
+
+// Passes plays on to another sink, dropping each one-tile play that
+// lays the same tile on the same square as one before it. This is the
+// filtering Generator::kibitz does.
+class DistinctMovesSink : public MoveSink
+{
+public:
+	DistinctMovesSink(MoveSink &sink);
+
+	virtual void consume(const PackedMove &move);
+
+	void clear();
+
+private:
+	// adds key to the set, returning false if it was already there
+	bool insert(int key);
+
+	MoveSink &m_sink;
+
+	// open-addressed set of the squares and tiles of the one-tile
+	// plays seen, with -1 in empty slots
+	std::vector<int> m_keys;
+	size_t m_keyCount;
+};
+
+// hands every play to a function
+class CallbackMoveSink : public MoveSink
+{
+public:
+	CallbackMoveSink(const std::function<void(const PackedMove &)> &callback);
+
+	virtual void consume(const PackedMove &move);
+
+private:
+	std::function<void(const PackedMove &)> m_callback;
+};
+
+inline void AllMovesSink::consume(const PackedMove &move)
+{
+	m_moves.push_back(move);
+}
+
+inline void AllMovesSink::clear()
+{
+	m_moves.clear();
+}
+
+inline const std::vector<PackedMove> &AllMovesSink::moves() const
+{
+	return m_moves;
+}
+
+inline std::vector<PackedMove> &AllMovesSink::moves()
+{
+	return m_moves;
+}
+
+inline void CallbackMoveSink::consume(const PackedMove &move)
+{
+	m_callback(move);
+}
+
+}
+
+#endif
@@ -23,7 +23,10 @@
 #include <quackleio/util.h>
 #include <reporter.h>
 #include <resolvent.h>
+#include <rollout.h>
+#include <simtrace.h>
 #include <strategyparameters.h>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -39,6 +42,10 @@ void simulateGames(int startGameIndex, int numGames,
                    std::map<int, int> &winnerInfo,
                    std::vector<std::chrono::duration<double>> &gameTimes,
                    std::map<int, TurnDurationInfo> &turnDurationInfo) {
+  // a stream of our own, so a run with the same seed and thread count
+  // plays the same games
+  dataManager.setRandomStream(startGameIndex + 1);
+
   for (int gameIndex = startGameIndex; gameIndex < startGameIndex + numGames;
        ++gameIndex) {
     auto start = std::chrono::high_resolution_clock::now();
@@ -166,11 +173,73 @@ void reportAverageTurnLengths(
   }
 }
 
+// Plays rolloutCnt rollouts of a few plies from a position of a
+// static-player game, first on copies of the game, then on one
+// RolloutPosition reset before each, and reports rollouts per second
+// for both.
+void benchmarkRollouts(Quackle::DataManager &dataManager, int rolloutCnt) {
+  const int plies = 4;
+
+  Quackle::Game game;
+  Quackle::PlayerList players;
+
+  Quackle::Player staticA(MARK_UV("Static A"),
+                          Quackle::Player::ComputerPlayerType, 1);
+  staticA.setComputerPlayer(new Quackle::StaticPlayer());
+  players.push_back(staticA);
+
+  Quackle::Player staticB(MARK_UV("Static B"),
+                          Quackle::Player::ComputerPlayerType, 1);
+  staticB.setComputerPlayer(new Quackle::StaticPlayer());
+  players.push_back(staticB);
+
+  game.setPlayers(players);
+  game.associateKnownComputerPlayers();
+  game.addPosition();
+  for (int i = 0; i < 6 && !game.currentPosition().gameOver(); ++i)
+    game.haveComputerPlay();
+
+  dataManager.seedRandomNumbers(1);
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < rolloutCnt; ++i) {
+    Quackle::Game copied(game);
+    for (int ply = 0; ply < plies && !copied.currentPosition().gameOver();
+         ++ply)
+      copied.commitMove(copied.currentPosition().staticBestMove());
+  }
+  const double copiedSeconds = std::chrono::duration<double>(
+                                   std::chrono::high_resolution_clock::now() -
+                                   start)
+                                   .count();
+
+  dataManager.seedRandomNumbers(1);
+  Quackle::RolloutPosition startPosition;
+  startPosition.reset(game);
+  Quackle::RolloutPosition rollout;
+  start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < rolloutCnt; ++i) {
+    rollout = startPosition;
+    for (int ply = 0; ply < plies && !rollout.position().gameOver(); ++ply)
+      rollout.commitMove(rollout.staticBestMove());
+  }
+  const double rolloutSeconds = std::chrono::duration<double>(
+                                    std::chrono::high_resolution_clock::now() -
+                                    start)
+                                    .count();
+
+  std::cout << rolloutCnt << " rollouts of " << plies << " plies" << std::endl;
+  std::cout << "Game copies: " << rolloutCnt / copiedSeconds
+            << " rollouts per second" << std::endl;
+  std::cout << "Rollout position: " << rolloutCnt / rolloutSeconds
+            << " rollouts per second" << std::endl;
+}
+
 int main(int argc, char *argv[]) {
   Quackle::DataManager dataManager;
 
   dataManager.setAppDataDirectory(
       "/Users/ethanmathieu/Library/Application Support/Quackle.org/Quackle");
+  dataManager.lexiconParameters()->setMemoryMapped(true);
   dataManager.lexiconParameters()->loadDawg(
       Quackle::LexiconParameters::findDictionaryFile("twl06.dawg"));
   dataManager.lexiconParameters()->loadGaddag(
@@ -178,6 +247,32 @@ int main(int argc, char *argv[]) {
   dataManager.strategyParameters()->initialize("twl98");
   dataManager.setBoardParameters(new Quackle::EnglishBoard());
 
+  if (argc > 1 && std::string(argv[1]) == "--rollouts") {
+    const int rolloutCnt = argc > 2 ? std::max(1, std::atoi(argv[2])) : 2000;
+    benchmarkRollouts(dataManager, rolloutCnt);
+    return 0;
+  }
+
+  if (argc > 1 && std::string(argv[1]) == "--sim-trace-to-xml") {
+    if (argc < 4) {
+      std::cerr << "usage: " << argv[0] << " --sim-trace-to-xml trace xml"
+                << std::endl;
+      return 1;
+    }
+    return Quackle::convertSimTraceToXml(argv[2], argv[3]) ? 0 : 1;
+  }
+
+  // converts a lexicon's strategy files under data/strategy to a bundle
+  if (argc > 1 && std::string(argv[1]) == "--strategy-bundle") {
+    if (argc < 4) {
+      std::cerr << "usage: " << argv[0] << " --strategy-bundle lexicon bundle"
+                << std::endl;
+      return 1;
+    }
+    dataManager.strategyParameters()->initializeFromText(argv[2]);
+    return dataManager.strategyParameters()->writeBundle(argv[3]) ? 0 : 1;
+  }
+
   int gameCnt = 100;
   if (argc > 1) {
     gameCnt = std::max(1, std::atoi(argv[1]));
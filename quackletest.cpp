@@ -16,19 +16,33 @@
  *  along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
 #include <string>
+#include <thread>
 
 #include "boardparameters.h"
 #include "bogowinplayer.h"
 #include "computerplayer.h"
 #include "computerplayercollection.h"
 #include "datamanager.h"
+#include "evaluator.h"
+#include "gaddag.h"
 #include "game.h"
+#include "gameparameters.h"
 #include "generator.h"
 #include "lexiconparameters.h"
+#include "movesink.h"
 #include "reporter.h"
 #include "sim.h"
+#include "simtrace.h"
 #include "strategyparameters.h"
 
 void testAdvanceToEnd(Quackle::Game &game);
@@ -39,6 +53,26 @@ void testEndgame(Quackle::Game &game);
 void testSimulation(Quackle::Game &game);
 void testValidator(Quackle::Game &game);
 void testGame();
+Quackle::Game makeStaticGame(int plays);
+int walkScore(const Quackle::Board &board, const Quackle::Move &move);
+// each of these returns how many mismatches it found
+int testIncrementalCrosses();
+int testPruneToBest();
+int testLeaveKeys();
+int testThreadedKibitz();
+int testMoveSinks();
+int testSimScheduler();
+int testRolloutPosition();
+int testCommonRandomNumbers();
+int testSimRace();
+int testSimTrace();
+int testSimCheckpoint();
+int testSimShards();
+int testRandomStreams();
+int testSuperleaves();
+int testStrategyBundle();
+void benchmarkIndexedGaddag();
+void benchmarkBoard();
 void testGameReport(const Quackle::Game &game);
 
 int main() {
@@ -57,12 +91,39 @@ int main() {
     dataManager.seedRandomNumbers('E' + 'm' + 'i' + 'l' + 'y' + 'Y' + 'K' +
                                   'o');
 
+  int mismatches = 0;
+  mismatches += testIncrementalCrosses();
+  mismatches += testPruneToBest();
+  mismatches += testLeaveKeys();
+  mismatches += testThreadedKibitz();
+  mismatches += testMoveSinks();
+  mismatches += testSimScheduler();
+  mismatches += testRolloutPosition();
+  mismatches += testCommonRandomNumbers();
+  mismatches += testSimRace();
+  mismatches += testSimTrace();
+  mismatches += testSimCheckpoint();
+  mismatches += testSimShards();
+  mismatches += testRandomStreams();
+  mismatches += testSuperleaves();
+  mismatches += testStrategyBundle();
+
+  const bool runBenchmarks = false;
+  if (runBenchmarks) {
+    benchmarkIndexedGaddag();
+    benchmarkBoard();
+  }
+
   const int gameCnt = 1000;
   // const int gameCnt = 1;
   for (int game = 0; game < gameCnt; ++game) {
     testGame();
   }
 
+  if (mismatches > 0) {
+    UVcout << mismatches << " mismatches in all" << endl;
+    return 1;
+  }
   return 0;
 }
 
@@ -249,6 +310,245 @@ void testSimulation(Quackle::Game &game) {
   }
 }
 
+// A new game between two static players, with plays moves made, or
+// fewer if the game ends first.
+Quackle::Game makeStaticGame(int plays) {
+  Quackle::Game game;
+
+  Quackle::PlayerList players;
+  Quackle::Player staticA(MARK_UV("StaticA"),
+                          Quackle::Player::ComputerPlayerType, 1);
+  staticA.setComputerPlayer(new Quackle::StaticPlayer());
+  players.push_back(staticA);
+  Quackle::Player staticB(MARK_UV("StaticB"),
+                          Quackle::Player::ComputerPlayerType, 1);
+  staticB.setComputerPlayer(new Quackle::StaticPlayer());
+  players.push_back(staticB);
+
+  game.setPlayers(players);
+  game.associateKnownComputerPlayers();
+  game.addPosition();
+  for (int i = 0; i < plays && !game.currentPosition().gameOver(); ++i)
+    game.haveComputerPlay();
+
+  return game;
+}
+
+// The score of move on board worked out without its cached hook
+// scores, by walking the word move forms across each square it fills.
+int walkScore(const Quackle::Board &board, const Quackle::Move &move) {
+  if (move.action != Quackle::Move::Place)
+    return 0;
+
+  const Quackle::AlphabetParameters *alphabet = QUACKLE_ALPHABET_PARAMETERS;
+  const Quackle::BoardParameters *boardParameters = QUACKLE_BOARD_PARAMETERS;
+  const int rowStep = move.horizontal ? 0 : 1;
+  const int colStep = move.horizontal ? 1 : 0;
+  const auto filled = [&board](int row, int col) {
+    return row >= 0 && row < board.height() && col >= 0 &&
+           col < board.width() && board.letter(row, col) != QUACKLE_NULL_MARK;
+  };
+  const auto tileScore = [&board, alphabet](int row, int col) {
+    return board.isBlank(row, col) ? 0
+                                   : alphabet->score(board.letter(row, col));
+  };
+
+  int laid = 0;
+  int mainScore = 0;
+  int hookScore = 0;
+  int wordMultiplier = 1;
+  int row = move.startrow;
+  int col = move.startcol;
+  for (const Quackle::Letter letter : move.tiles()) {
+    if (filled(row, col)) {
+      mainScore += tileScore(row, col);
+    } else {
+      const int letterScore =
+          alphabet->isPlainLetter(letter)
+              ? alphabet->score(letter) *
+                    boardParameters->letterMultiplier(row, col)
+              : 0;
+      mainScore += letterScore;
+      wordMultiplier *= boardParameters->wordMultiplier(row, col);
+      ++laid;
+
+      // across the play, both ways from the square
+      int crossScore = 0;
+      bool crossed = false;
+      for (int way = -1; way <= 1; way += 2) {
+        for (int r = row + way * colStep, c = col + way * rowStep;
+             filled(r, c); r += way * colStep, c += way * rowStep) {
+          crossScore += tileScore(r, c);
+          crossed = true;
+        }
+      }
+      if (crossed)
+        hookScore += (crossScore + letterScore) *
+                     boardParameters->wordMultiplier(row, col);
+    }
+
+    row += rowStep;
+    col += colStep;
+  }
+
+  int total = hookScore;
+  if (move.tiles().length() > 1)
+    total += mainScore * wordMultiplier;
+  if (laid == QUACKLE_PARAMETERS->rackSize())
+    total += QUACKLE_PARAMETERS->bingoBonus();
+  return total;
+}
+
+// Plays out static-player games and checks after every move that the
+// incrementally maintained crosses match a full allCrosses rebuild,
+// and that Board::score gives the next plays what walkScore does.
+int testIncrementalCrosses() {
+  const int gameCnt = 20;
+  int movesChecked = 0;
+  int playsScored = 0;
+  int mismatches = 0;
+
+  for (int i = 0; i < gameCnt; ++i) {
+    Quackle::Game game = makeStaticGame(0);
+
+    while (!game.currentPosition().gameOver()) {
+      const Quackle::Move move(game.haveComputerPlay());
+      ++movesChecked;
+
+      const Quackle::Board &incremental = game.currentPosition().board();
+      Quackle::GamePosition rebuilt(game.currentPosition());
+      rebuilt.ensureBoardIsPreparedForAnalysis();
+      const Quackle::Board &full = rebuilt.board();
+
+      for (int row = 0; row < full.height(); ++row) {
+        for (int col = 0; col < full.width(); ++col) {
+          if (incremental.vcross(row, col) != full.vcross(row, col) ||
+              incremental.hcross(row, col) != full.hcross(row, col)) {
+            UVcout << "cross mismatch at " << row << ", " << col
+                   << " after " << move << endl;
+            ++mismatches;
+          }
+        }
+      }
+
+      rebuilt.kibitz(100);
+      for (const auto &play : rebuilt.moves()) {
+        if (play.action != Quackle::Move::Place)
+          continue;
+        ++playsScored;
+        if (incremental.score(play) != walkScore(incremental, play)) {
+          UVcout << "hook score mismatch for " << play << " after " << move
+                 << ": " << incremental.score(play) << " vs "
+                 << walkScore(incremental, play) << endl;
+          ++mismatches;
+        }
+      }
+    }
+  }
+
+  UVcout << "incremental crosses: checked " << movesChecked << " moves, "
+         << playsScored << " plays scored, " << mismatches << " mismatches"
+         << endl;
+
+  return mismatches;
+}
+
+// Checks on every position of some static-player games that the pruned
+// best-move search finds exactly what exhaustive generation does. Only
+// gordongenerate prunes, so this needs a gaddag.
+int testPruneToBest() {
+  const int gameCnt = 20;
+  int positionsChecked = 0;
+  int mismatches = 0;
+
+  if (!QUACKLE_LEXICON_PARAMETERS->hasGaddag()) {
+    UVcout << "prune to best: no gaddag loaded" << endl;
+    return 0;
+  }
+
+  for (int i = 0; i < gameCnt; ++i) {
+    Quackle::Game game = makeStaticGame(0);
+
+    while (!game.currentPosition().gameOver()) {
+      Quackle::GamePosition position(game.currentPosition());
+      const Quackle::Move exhaustive(position.staticBestMove(false));
+      const Quackle::Move pruned(position.staticBestMove(true));
+      ++positionsChecked;
+
+      if (!(exhaustive == pruned) || exhaustive.equity != pruned.equity) {
+        UVcout << "pruned best move " << pruned << " differs from "
+               << exhaustive << endl;
+        ++mismatches;
+      }
+
+      game.haveComputerPlay();
+    }
+  }
+
+  UVcout << "prune to best: checked " << positionsChecked << " positions, "
+         << mismatches << " mismatches" << endl;
+
+  return mismatches;
+}
+
+// Checks that the equity the generator gives each play from the leave
+// key it keeps is the evaluator's equity of the play, and that each
+// distinct exchange comes up once.
+int testLeaveKeys() {
+  const int gameCnt = 10;
+  int movesChecked = 0;
+  int mismatches = 0;
+
+  for (int i = 0; i < gameCnt; ++i) {
+    Quackle::Game game = makeStaticGame(0);
+
+    while (!game.currentPosition().gameOver()) {
+      const Quackle::GamePosition &position = game.currentPosition();
+      Quackle::Generator generator(position);
+      Quackle::AllMovesSink all;
+      generator.generateInto(all);
+
+      std::set<Quackle::LetterString> exchanges;
+      int exchangeCount = 0;
+      for (const auto &packed : all.moves()) {
+        const Quackle::Move move(packed.toMove());
+        ++movesChecked;
+        if (move.equity != QUACKLE_EVALUATOR->equity(position, move)) {
+          UVcout << "leave key equity of " << move << " is " << move.equity
+                 << endl;
+          ++mismatches;
+        }
+
+        if (move.action == Quackle::Move::Exchange) {
+          exchanges.insert(move.tiles());
+          ++exchangeCount;
+        }
+      }
+
+      // one for each way of throwing some of each letter
+      int throws = 1;
+      char counts[QUACKLE_FIRST_LETTER + QUACKLE_MAXIMUM_ALPHABET_SIZE];
+      Quackle::String::counts(position.currentPlayer().rack().tiles(),
+                              counts);
+      for (int letter = 0; letter < (int)sizeof(counts); ++letter)
+        throws *= counts[letter] + 1;
+      if (exchangeCount != (int)exchanges.size() ||
+          (exchangeCount > 0 && exchangeCount != throws - 1)) {
+        UVcout << exchangeCount << " exchanges of "
+               << position.currentPlayer().rack() << endl;
+        ++mismatches;
+      }
+
+      game.haveComputerPlay();
+    }
+  }
+
+  UVcout << "leave keys: checked " << movesChecked << " moves, " << mismatches
+         << " mismatches" << endl;
+
+  return mismatches;
+}
+
 void testValidator(Quackle::Game &game) {
   game.commitMove(Quackle::Move::createPlaceMove(
       MARK_UV("8d"), QUACKLE_ALPHABET_PARAMETERS->encode(MARK_UV("MANIA"))));
@@ -265,3 +565,956 @@ void testValidator(Quackle::Game &game) {
       Quackle::Move::createPlaceMove(
           MARK_UV("9c"), QUACKLE_ALPHABET_PARAMETERS->encode(MARK_UV("AI"))));
 }
+
+// Checks on every position of some static-player games that kibitzing
+// on several threads gives exactly the serial move list.
+int testThreadedKibitz() {
+  const int gameCnt = 10;
+  const int threadCount = 4;
+  int positionsChecked = 0;
+  int mismatches = 0;
+
+  for (int i = 0; i < gameCnt; ++i) {
+    Quackle::Game game = makeStaticGame(0);
+
+    while (!game.currentPosition().gameOver()) {
+      Quackle::GamePosition serial(game.currentPosition());
+      Quackle::GamePosition threaded(game.currentPosition());
+      serial.kibitz(1000);
+      threaded.kibitz(1000, false, threadCount);
+      ++positionsChecked;
+
+      const Quackle::MoveList &serialMoves = serial.moves();
+      const Quackle::MoveList &threadedMoves = threaded.moves();
+      bool same = serialMoves.size() == threadedMoves.size();
+      for (size_t j = 0; same && j < serialMoves.size(); ++j)
+        same = serialMoves[j] == threadedMoves[j] &&
+               serialMoves[j].equity == threadedMoves[j].equity;
+
+      if (!same) {
+        UVcout << "threaded kibitz differs on position "
+               << game.currentPosition() << endl;
+        ++mismatches;
+      }
+
+      game.haveComputerPlay();
+    }
+  }
+
+  UVcout << "threaded kibitz: checked " << positionsChecked << " positions, "
+         << mismatches << " mismatches" << endl;
+
+  return mismatches;
+}
+
+// Checks on every position of some static-player games that the
+// move sinks see the same plays: the callback as many as the full
+// list, and the top-moves heap the head of the full list once sorted.
+// Also checks that kibitz, which keeps only the best plays, lists the
+// head of allPossiblePlays().
+int testMoveSinks() {
+  const int gameCnt = 10;
+  const size_t topCount = 20;
+  int positionsChecked = 0;
+  int mismatches = 0;
+
+  for (int i = 0; i < gameCnt; ++i) {
+    Quackle::Game game = makeStaticGame(0);
+
+    while (!game.currentPosition().gameOver()) {
+      const int flags = game.currentPosition().exchangeAllowed()
+                            ? Quackle::Generator::RegularKibitz
+                            : Quackle::Generator::CannotExchange;
+      Quackle::Generator generator(game.currentPosition());
+
+      Quackle::AllMovesSink all;
+      generator.generateInto(all, flags);
+
+      Quackle::TopMovesSink top(topCount);
+      generator.generateInto(top, flags);
+
+      size_t called = 0;
+      Quackle::CallbackMoveSink callback(
+          [&called](const Quackle::PackedMove &) { ++called; });
+      generator.generateInto(callback, flags);
+
+      generator.kibitz(topCount, flags);
+      const Quackle::MoveList kibitzMoves = generator.kibitzList();
+      const Quackle::MoveList &possibleMoves = generator.allPossiblePlays();
+      ++positionsChecked;
+
+      Quackle::MoveList allMoves;
+      for (const auto &move : all.moves())
+        allMoves.push_back(move.toMove());
+      Quackle::MoveList::sort(allMoves, Quackle::MoveList::Equity);
+
+      const Quackle::MoveList topMoves = top.moves();
+      bool same = called == allMoves.size() &&
+                  topMoves.size() == min(topCount, allMoves.size());
+      for (size_t j = 0; same && j < topMoves.size(); ++j)
+        same = topMoves[j] == allMoves[j] &&
+               topMoves[j].equity == allMoves[j].equity;
+
+      same = same &&
+             kibitzMoves.size() == min(topCount, possibleMoves.size());
+      for (size_t j = 0; same && j < kibitzMoves.size(); ++j)
+        same = kibitzMoves[j] == possibleMoves[j] &&
+               kibitzMoves[j].equity == possibleMoves[j].equity;
+
+      if (!same) {
+        UVcout << "move sinks differ on position " << game.currentPosition()
+               << endl;
+        ++mismatches;
+      }
+
+      game.haveComputerPlay();
+    }
+  }
+
+  UVcout << "move sinks: checked " << positionsChecked << " positions, "
+         << mismatches << " mismatches" << endl;
+
+  return mismatches;
+}
+
+// Simulates the same position with different numbers of threads and
+// checks that every candidate gets exactly one playahead per iteration,
+// each opening with the candidate's own score, and that the summed
+// statistics agree with the playaheads.
+int testSimScheduler() {
+  const int iterations = 40;
+  const int plies = 2;
+  int movesChecked = 0;
+  int mismatches = 0;
+
+  Quackle::Game game = makeStaticGame(4);
+  game.currentPosition().kibitz(10);
+
+  const size_t threadCounts[] = {0, 1, 4};
+  for (size_t threadCount : threadCounts) {
+    Quackle::Simulator simulator;
+    simulator.setThreadCount(threadCount);
+    simulator.setPosition(game.currentPosition());
+    simulator.simulate(plies, iterations);
+
+    if (simulator.iterations() != iterations)
+      ++mismatches;
+
+    for (const auto &simmedMove : simulator.simmedMoves()) {
+      ++movesChecked;
+      const Quackle::AveragedValue &candidateScore =
+          simmedMove.levels[0].statistics[0].score;
+      if (simmedMove.wins.incorporatedValues() != iterations ||
+          simmedMove.residual.incorporatedValues() != iterations ||
+          candidateScore.incorporatedValues() != iterations ||
+          candidateScore.averagedValue() != simmedMove.move.score ||
+          simmedMove.playaheadEquity.incorporatedValues() != iterations ||
+          !simmedMove.playaheads.empty() ||
+          fabs(simmedMove.calculateEquity() -
+               simmedMove.playaheadValues().averagedValue()) > 1e-6) {
+        UVcout << "sim with " << threadCount << " threads got " << simmedMove
+               << endl;
+        ++mismatches;
+      }
+    }
+  }
+
+  UVcout << "sim scheduler: checked " << movesChecked << " moves, "
+         << mismatches << " mismatches" << endl;
+
+  return mismatches;
+}
+
+// From every position of some static-player games, plays a few plies
+// ahead (as the simulator does, stopping at the end of the game) both
+// on a copy of the game and on a RolloutPosition, drawing the same
+// tiles, and checks that they end up in the same position.
+int testRolloutPosition() {
+  const int gameCnt = 10;
+  const int plies = 4;
+  int positionsChecked = 0;
+  int mismatches = 0;
+
+  for (int i = 0; i < gameCnt; ++i) {
+    Quackle::Game game = makeStaticGame(0);
+
+    while (!game.currentPosition().gameOver()) {
+      const unsigned int seed = positionsChecked;
+
+      Quackle::DataManager::self()->seedRandomNumbers(seed);
+      Quackle::Game copied(game);
+      for (int ply = 0; ply < plies && !copied.currentPosition().gameOver();
+           ++ply)
+        copied.commitMove(copied.currentPosition().staticBestMove());
+
+      Quackle::DataManager::self()->seedRandomNumbers(seed);
+      Quackle::RolloutPosition rollout;
+      rollout.reset(game);
+      for (int ply = 0; ply < plies && !rollout.position().gameOver(); ++ply)
+        rollout.commitMove(rollout.staticBestMove());
+      ++positionsChecked;
+
+      std::ostringstream copiedText, rolloutText;
+      copiedText << copied.currentPosition();
+      rolloutText << rollout.position();
+      if (copiedText.str() != rolloutText.str()) {
+        UVcout << "rollout differs from game after " << game.currentPosition()
+               << endl;
+        ++mismatches;
+      }
+
+      game.haveComputerPlay();
+    }
+  }
+
+  UVcout << "rollout position: checked " << positionsChecked << " positions, "
+         << mismatches << " mismatches" << endl;
+
+  return mismatches;
+}
+
+// Simulates some candidates together with common random numbers, then
+// again one after another, and checks that each candidate's playaheads
+// come out the same both times.
+int testCommonRandomNumbers() {
+  const int iterations = 20;
+  // just the candidate and the reply, so exchanges tossing tiles back
+  // at random can't change anything
+  const int plies = 1;
+  int playaheadsChecked = 0;
+  int mismatches = 0;
+
+  Quackle::Game game = makeStaticGame(4);
+  game.currentPosition().kibitz(5);
+
+  Quackle::Simulator simulator;
+  simulator.setCommonRandomNumbers(true);
+  simulator.setPosition(game.currentPosition());
+  simulator.simulate(plies, iterations);
+  const Quackle::SimmedMoveList together(simulator.simmedMoves());
+
+  simulator.resetNumbers();
+  for (const auto &simmedMove : together) {
+    Quackle::MoveList alone;
+    alone.push_back(simmedMove.move);
+    simulator.setIncludedMoves(alone);
+    simulator.simulate(plies, iterations);
+  }
+
+  for (const auto &simmedMove : together) {
+    const Quackle::SimmedMove &alone =
+        simulator.simmedMoveForMove(simmedMove.move);
+    if (alone.playaheads.size() != simmedMove.playaheads.size()) {
+      ++mismatches;
+      continue;
+    }
+
+    for (size_t i = 0; i < alone.playaheads.size(); ++i) {
+      ++playaheadsChecked;
+      if (alone.playaheads[i].equity != simmedMove.playaheads[i].equity ||
+          alone.playaheads[i].wins != simmedMove.playaheads[i].wins) {
+        UVcout << "playahead " << i << " of " << simmedMove.move
+               << " differs when simmed alone" << endl;
+        ++mismatches;
+      }
+    }
+  }
+
+  UVcout << "common random numbers: checked " << playaheadsChecked
+         << " playaheads, " << mismatches << " mismatches" << endl;
+
+  return mismatches;
+}
+
+// Races some candidates and a pass, with and without common random
+// numbers, and checks that the pass is dropped, a considered move is
+// kept, and the survivors got every iteration.
+int testSimRace() {
+  const int maxIterations = 96;
+  const int plies = 2;
+  int racesChecked = 0;
+  int mismatches = 0;
+
+  Quackle::Game game = makeStaticGame(4);
+  game.currentPosition().kibitz(8);
+
+  const Quackle::Move pass = Quackle::Move::createPassMove();
+  for (int common = 0; common < 2; ++common) {
+    Quackle::Simulator simulator;
+    simulator.setCommonRandomNumbers(common != 0);
+    simulator.setPosition(game.currentPosition());
+    Quackle::MoveList candidates(game.currentPosition().moves());
+    candidates.push_back(pass);
+    simulator.setIncludedMoves(candidates);
+    const Quackle::Move considered = candidates[candidates.size() - 2];
+    simulator.addConsideredMove(considered);
+
+    const int iterations =
+        simulator.race(plies, maxIterations, /* no time limit */ 0);
+    ++racesChecked;
+
+    const Quackle::MoveList survivors(simulator.moves(/* prune */ true));
+    if (iterations != simulator.iterations() || iterations > maxIterations ||
+        survivors.contains(pass) || !survivors.contains(considered)) {
+      UVcout << "race got " << iterations << " iterations, survivors "
+             << survivors << endl;
+      ++mismatches;
+    }
+
+    for (const auto &move : survivors) {
+      if (simulator.simmedMoveForMove(move)
+              .playaheadEquity.incorporatedValues() != iterations) {
+        UVcout << "survivor " << move << " missed iterations" << endl;
+        ++mismatches;
+      }
+    }
+  }
+
+  UVcout << "sim race: checked " << racesChecked << " races, " << mismatches
+         << " mismatches" << endl;
+
+  return mismatches;
+}
+
+// Simulates with a trace log on several threads, converts the trace
+// and checks the XML has every iteration in order, each with a
+// playahead of every candidate, each of every ply, and that the XML
+// log is not appended to as a trace.
+int testSimTrace() {
+  const int iterations = 12;
+  const int plies = 2;
+  const int candidates = 5;
+  const string traceFile = "quackletest.simtrace";
+  const string xmlFile = "quackletest.simulation.xml";
+  int linesChecked = 0;
+  int mismatches = 0;
+
+  Quackle::Game game = makeStaticGame(4);
+  game.currentPosition().kibitz(candidates);
+
+  {
+    Quackle::Simulator simulator;
+    simulator.setThreadCount(3);
+    simulator.setLogfile(traceFile, false);
+    simulator.setPosition(game.currentPosition());
+    simulator.simulate(plies, iterations);
+    simulator.closeLogfile();
+  }
+
+  if (!Quackle::convertSimTraceToXml(traceFile, xmlFile))
+    ++mismatches;
+
+  ifstream xml(xmlFile.c_str());
+  int simulations = 0;
+  int iteration = 0;
+  int playaheads = 0;
+  int expectedPly = 0;
+  string line;
+  while (getline(xml, line)) {
+    ++linesChecked;
+    int index = 0;
+    if (line == "<simulation>") {
+      ++simulations;
+    } else if (sscanf(line.c_str(), "\t<iteration index=\"%d\">", &index) ==
+               1) {
+      if (index != ++iteration)
+        ++mismatches;
+      playaheads = 0;
+    } else if (line == "\t</iteration>") {
+      if (playaheads != candidates)
+        ++mismatches;
+    } else if (sscanf(line.c_str(), "\t\t<ply index=\"%d\">", &index) == 1) {
+      if (index != expectedPly++)
+        ++mismatches;
+    } else if (line == "\t\t<playahead>") {
+      if (expectedPly != plies + 1)
+        ++mismatches;
+      expectedPly = 0;
+      ++playaheads;
+    }
+  }
+
+  if (simulations != 1 || iteration != iterations) {
+    UVcout << "sim trace: " << simulations << " simulations of " << iteration
+           << " iterations" << endl;
+    ++mismatches;
+  }
+
+  // a trace may be appended to, but the XML log may not
+  {
+    Quackle::Simulator simulator;
+    simulator.setLogfile(traceFile, true);
+    if (!simulator.isLogging())
+      ++mismatches;
+    simulator.setLogfile(xmlFile, true);
+    if (simulator.isLogging())
+      ++mismatches;
+  }
+  if (!Quackle::convertSimTraceToXml(traceFile, xmlFile))
+    ++mismatches;
+
+  UVcout << "sim trace: checked " << linesChecked << " lines, " << mismatches
+         << " mismatches" << endl;
+
+  return mismatches;
+}
+
+// Saves a simulation with common random numbers halfway and checks
+// that one restored from the checkpoint carries on to the same
+// playaheads, that merging a checkpoint twice doubles its numbers, and
+// that a checkpoint of another position is refused.
+int testSimCheckpoint() {
+  const int iterations = 10;
+  const int plies = 1;
+  const string checkpointFile = "quackletest.simcheckpoint";
+  int movesChecked = 0;
+  int mismatches = 0;
+
+  Quackle::Game game = makeStaticGame(4);
+  game.currentPosition().kibitz(5);
+
+  Quackle::Simulator original;
+  original.setCommonRandomNumbers(true);
+  original.setPosition(game.currentPosition());
+  original.simulate(plies, iterations);
+  if (!original.saveCheckpoint(checkpointFile))
+    ++mismatches;
+  const Quackle::SimmedMoveList halfway(original.simmedMoves());
+  original.simulate(plies, iterations);
+
+  Quackle::Simulator restored;
+  restored.setCommonRandomNumbers(true);
+  restored.setPosition(game.currentPosition());
+  if (!restored.restoreCheckpoint(checkpointFile))
+    ++mismatches;
+  restored.simulate(plies, iterations);
+
+  Quackle::Simulator merged;
+  merged.setPosition(game.currentPosition());
+  if (!merged.mergeCheckpoint(checkpointFile) ||
+      !merged.mergeCheckpoint(checkpointFile))
+    ++mismatches;
+
+  if (restored.iterations() != original.iterations() ||
+      merged.iterations() != 2 * iterations)
+    ++mismatches;
+
+  for (const auto &simmedMove : original.simmedMoves()) {
+    ++movesChecked;
+    const Quackle::SimmedMove &carriedOn =
+        restored.simmedMoveForMove(simmedMove.move);
+    if (carriedOn.playaheads.size() != simmedMove.playaheads.size() ||
+        std::fabs(carriedOn.calculateEquity() - simmedMove.calculateEquity()) >
+            1e-9) {
+      UVcout << simmedMove.move << " differs when restored" << endl;
+      ++mismatches;
+      continue;
+    }
+    for (size_t i = 0; i < simmedMove.playaheads.size(); ++i)
+      if (carriedOn.playaheads[i].equity != simmedMove.playaheads[i].equity)
+        ++mismatches;
+  }
+
+  for (const auto &simmedMove : halfway) {
+    ++movesChecked;
+    const Quackle::SimmedMove &twice =
+        merged.simmedMoveForMove(simmedMove.move);
+    if (twice.wins.incorporatedValues() !=
+            2 * simmedMove.wins.incorporatedValues() ||
+        twice.playaheadEquity.incorporatedValues() !=
+            2 * simmedMove.playaheadEquity.incorporatedValues() ||
+        twice.playaheads.size() != 2 * simmedMove.playaheads.size() ||
+        std::fabs(twice.calculateEquity() - simmedMove.calculateEquity()) >
+            1e-9) {
+      UVcout << simmedMove.move << " differs when merged twice" << endl;
+      ++mismatches;
+    }
+  }
+
+  game.haveComputerPlay();
+  Quackle::Simulator elsewhere;
+  elsewhere.setPosition(game.currentPosition());
+  if (elsewhere.restoreCheckpoint(checkpointFile) ||
+      elsewhere.mergeCheckpoint(checkpointFile))
+    ++mismatches;
+
+  UVcout << "sim checkpoint: checked " << movesChecked << " moves, "
+         << mismatches << " mismatches" << endl;
+
+  return mismatches;
+}
+
+// Splits a simulation among worker processes and checks every move
+// got each process's iterations, and that the processes didn't all
+// play out the same tiles.
+int testSimShards() {
+  const int shards = 3;
+  const int iterations = 12;
+  const int plies = 2;
+  int movesChecked = 0;
+  int mismatches = 0;
+
+  Quackle::Game game = makeStaticGame(4);
+  game.currentPosition().kibitz(5);
+
+  for (int common = 0; common < 2; ++common) {
+    Quackle::Simulator simulator;
+    simulator.setCommonRandomNumbers(common != 0);
+    simulator.setPosition(game.currentPosition());
+    simulator.simulateSharded(plies, iterations, shards);
+
+    if (simulator.iterations() != iterations)
+      ++mismatches;
+
+    const int share = iterations / shards;
+    for (const auto &simmedMove : simulator.simmedMoves()) {
+      ++movesChecked;
+      const auto &playaheads = simmedMove.playaheads;
+      if (simmedMove.playaheadEquity.incorporatedValues() != iterations ||
+          simmedMove.wins.incorporatedValues() != iterations ||
+          playaheads.size() != size_t(common ? iterations : 0)) {
+        UVcout << simmedMove.move << " got " << playaheads.size()
+               << " playaheads from the shards" << endl;
+        ++mismatches;
+        continue;
+      }
+
+      // only common random numbers keep the playaheads to compare
+      if (!common)
+        continue;
+
+      bool sameAsFirstShard = true;
+      for (int i = 0; i < share; ++i)
+        if (playaheads[i].equity != playaheads[share + i].equity)
+          sameAsFirstShard = false;
+      if (sameAsFirstShard) {
+        UVcout << simmedMove.move << " played the same in two shards" << endl;
+        ++mismatches;
+      }
+    }
+  }
+
+  // an abort kills the shards rather than waiting on a million
+  // iterations
+  {
+    struct AbortingDispatch : public Quackle::ComputerDispatch {
+      bool shouldAbort() override { return true; }
+      void signalFractionDone(double) override {}
+    } dispatch;
+
+    Quackle::Simulator simulator;
+    simulator.setDispatch(&dispatch);
+    simulator.setPosition(game.currentPosition());
+    simulator.simulateSharded(plies, 1000000, shards);
+    if (simulator.iterations() != 0)
+      ++mismatches;
+  }
+
+  UVcout << "sim shards: checked " << movesChecked << " moves, " << mismatches
+         << " mismatches" << endl;
+
+  return mismatches;
+}
+
+// Draws from the seeding thread's stream, two numbered streams and an
+// unnumbered one on threads started in different orders, twice from the
+// same seed, and checks each stream draws the same both times and
+// differently from the others.
+int testRandomStreams() {
+  const int draws = 100;
+  const int streams = 4;
+  int drawsChecked = 0;
+  int mismatches = 0;
+
+  auto drawFrom = [](int stream, vector<int> &drawn) {
+    if (stream > 0)
+      QUACKLE_DATAMANAGER->setRandomStream(stream);
+    for (int i = 0; i < draws; ++i)
+      drawn.push_back(QUACKLE_DATAMANAGER->randomInteger(0, 1 << 30));
+  };
+
+  vector<vector<int>> runs[2];
+  for (int run = 0; run < 2; ++run) {
+    QUACKLE_DATAMANAGER->seedRandomNumbers(7);
+    vector<vector<int>> &drawn = runs[run];
+    drawn.resize(streams);
+
+    // the last is unnumbered
+    vector<std::thread> threads;
+    for (int i = 1; i < streams; ++i) {
+      const int thread = run == 0 ? i : streams - i;
+      const int stream = thread == streams - 1 ? -1 : thread;
+      threads.push_back(std::thread(drawFrom, stream, std::ref(drawn[thread])));
+      threads.back().join();
+    }
+    drawFrom(0, drawn[0]);
+  }
+
+  for (int i = 0; i < streams; ++i) {
+    drawsChecked += draws;
+    if (runs[0][i] != runs[1][i]) {
+      UVcout << "stream " << i << " drew differently from the same seed"
+             << endl;
+      ++mismatches;
+    }
+    for (int j = 0; j < i; ++j)
+      if (runs[0][i] == runs[0][j]) {
+        UVcout << "streams " << i << " and " << j << " drew the same" << endl;
+        ++mismatches;
+      }
+  }
+
+  UVcout << "random streams: checked " << drawsChecked << " draws, "
+         << mismatches << " mismatches" << endl;
+
+  return mismatches;
+}
+
+// loads superleave files the strategy directory doesn't have
+class SuperleaveParameters : public Quackle::StrategyParameters {
+public:
+  bool load(const string &filename) {
+    return m_hasSuperleaves = loadSuperleaves(filename);
+  }
+};
+
+// Writes a superleave file of every other leave of some random racks,
+// loads it, and checks each leave gets the value it was written with,
+// or zero if it wasn't written or isn't alphabetized.
+int testSuperleaves() {
+  const string superleaveFile = "quackletest.superleaves";
+  int leavesChecked = 0;
+  int mismatches = 0;
+
+  std::map<Quackle::LetterString, double> written;
+  vector<Quackle::LetterString> unwritten;
+  {
+    ofstream file(superleaveFile.c_str(), ios::out | ios::binary);
+    for (int i = 0; i < 2000; ++i) {
+      Quackle::Bag bag;
+      Quackle::LetterString leave;
+      const int length = 1 + i % 6;
+      for (int j = 0; j < length; ++j)
+        leave.push_back(bag.pluck());
+      leave = Quackle::String::alphabetize(leave);
+      if (written.count(leave))
+        continue;
+
+      if (i % 2) {
+        unwritten.push_back(leave);
+        continue;
+      }
+
+      // as the files store them, in 256ths offset by 128
+      const unsigned int stored = 128 * 256 + (i % 4000) - 1000 + 1;
+      written[leave] = double(stored) / 256.0 - 128.0;
+      file.put(char(leave.length()));
+      file.write(leave.constData(), leave.length());
+      file.put(char(stored & 0xff));
+      file.put(char(stored >> 8));
+    }
+  }
+
+  SuperleaveParameters parameters;
+  if (!parameters.load(superleaveFile))
+    ++mismatches;
+
+  for (const auto &leave : written) {
+    ++leavesChecked;
+    if (parameters.superleave(leave.first) != leave.second)
+      ++mismatches;
+
+    Quackle::LetterString reversed;
+    for (int i = leave.first.length() - 1; i >= 0; --i)
+      reversed.push_back(leave.first[i]);
+    if (reversed != leave.first && parameters.superleave(reversed) != 0)
+      ++mismatches;
+  }
+
+  for (const auto &leave : unwritten) {
+    ++leavesChecked;
+    if (!written.count(leave) && parameters.superleave(leave) != 0)
+      ++mismatches;
+  }
+
+  UVcout << "superleaves: checked " << leavesChecked << " leaves, "
+         << mismatches << " mismatches" << endl;
+
+  return mismatches;
+}
+
+// Follows the same letters down a gaddag from the root, starting over
+// whenever a letter has no child; returns how many terminals it passed.
+template <class Node>
+long walkGaddag(const Node *root, const vector<Quackle::Letter> &letters) {
+  long terminals = 0;
+  const Node *node = root;
+  for (size_t i = 0; i < letters.size(); ++i) {
+    node = node->child(letters[i]);
+    if (!node)
+      node = root;
+    else if (node->isTerminal())
+      ++terminals;
+  }
+  return terminals;
+}
+
+// Writes the strategy loaded from text files, with the superleaves
+// testSuperleaves wrote, to a bundle and checks that every lookup on
+// the bundle gives what it does on the text files, and that a cut-off
+// bundle isn't loaded.
+int testStrategyBundle() {
+  const string bundleFile = "quackletest.bundle";
+  int lookupsChecked = 0;
+  int mismatches = 0;
+
+  SuperleaveParameters text;
+  text.initialize("twl06");
+  text.load("quackletest.superleaves");
+  if (!text.writeBundle(bundleFile))
+    ++mismatches;
+
+  Quackle::StrategyParameters bundle;
+  if (!bundle.loadBundle(bundleFile))
+    ++mismatches;
+
+  const auto check = [&](double expected, double found) {
+    ++lookupsChecked;
+    if (expected != found)
+      ++mismatches;
+  };
+
+  if (bundle.hasSyn2() != text.hasSyn2() ||
+      bundle.hasWorths() != text.hasWorths() ||
+      bundle.hasVcPlace() != text.hasVcPlace() ||
+      bundle.hasBogowin() != text.hasBogowin() ||
+      bundle.hasSuperleaves() != text.hasSuperleaves())
+    ++mismatches;
+
+  const Quackle::Letter lastLetter = QUACKLE_ALPHABET_PARAMETERS->lastLetter();
+  for (Quackle::Letter i = QUACKLE_BLANK_MARK; i <= lastLetter; ++i) {
+    check(text.tileWorth(i), bundle.tileWorth(i));
+    for (Quackle::Letter j = QUACKLE_BLANK_MARK; j <= lastLetter; ++j)
+      check(text.syn2(i, j), bundle.syn2(i, j));
+  }
+
+  for (int start = 0; start < QUACKLE_MAXIMUM_BOARD_SIZE; ++start)
+    for (int length = 0; length < QUACKLE_MAXIMUM_BOARD_SIZE; ++length)
+      for (int consbits = 0; consbits < 128; consbits += 3)
+        check(text.vcPlace(start, length, consbits),
+              bundle.vcPlace(start, length, consbits));
+
+  for (int lead = -310; lead <= 310; ++lead)
+    for (int unseen = 0; unseen < 100; unseen += 7)
+      check(text.bogowin(lead, unseen, 0), bundle.bogowin(lead, unseen, 0));
+
+  for (int i = 0; i < 2000; ++i) {
+    Quackle::Bag bag;
+    Quackle::LetterString leave;
+    for (int j = 0; j < 1 + i % 6; ++j)
+      leave.push_back(bag.pluck());
+    leave = Quackle::String::alphabetize(leave);
+    check(text.superleave(leave), bundle.superleave(leave));
+  }
+
+  // a bundle can be written over the file it is mapped from
+  if (!bundle.writeBundle(bundleFile))
+    ++mismatches;
+  Quackle::StrategyParameters rewritten;
+  if (!rewritten.loadBundle(bundleFile))
+    ++mismatches;
+  for (Quackle::Letter i = QUACKLE_BLANK_MARK; i <= lastLetter; ++i) {
+    check(text.tileWorth(i), rewritten.tileWorth(i));
+    for (Quackle::Letter j = QUACKLE_BLANK_MARK; j <= lastLetter; ++j)
+      check(text.syn2(i, j), rewritten.syn2(i, j));
+  }
+  for (int i = 0; i < 200; ++i) {
+    Quackle::Bag bag;
+    Quackle::LetterString leave;
+    for (int j = 0; j < 1 + i % 6; ++j)
+      leave.push_back(bag.pluck());
+    leave = Quackle::String::alphabetize(leave);
+    check(text.superleave(leave), rewritten.superleave(leave));
+  }
+
+  // a bundle cut short is turned down
+  {
+    ifstream in(bundleFile.c_str(), ios::in | ios::binary);
+    const string contents((std::istreambuf_iterator<char>(in)),
+                          std::istreambuf_iterator<char>());
+    ofstream out(bundleFile.c_str(), ios::out | ios::binary | ios::trunc);
+    out.write(contents.data(), contents.size() / 2);
+  }
+  Quackle::StrategyParameters truncated;
+  if (truncated.loadBundle(bundleFile) || truncated.hasSyn2())
+    ++mismatches;
+
+  UVcout << "strategy bundle: checked " << lookupsChecked << " lookups, "
+         << mismatches << " mismatches" << endl;
+
+  return mismatches;
+}
+
+// Times child lookups and move generation on the loaded gaddag against
+// its IndexedGaddagNode layout, and checks both generate the same moves.
+void benchmarkIndexedGaddag() {
+  Quackle::LexiconParameters *lexicon = QUACKLE_LEXICON_PARAMETERS;
+  if (!lexicon->hasGaddag()) {
+    UVcout << "indexed gaddag: no gaddag loaded" << endl;
+    return;
+  }
+
+  const bool wasIndexed = lexicon->indexGaddag();
+  lexicon->setIndexGaddag(false);
+
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<int> letterDistribution(
+      QUACKLE_FIRST_LETTER - 1, QUACKLE_ALPHABET_PARAMETERS->lastLetter());
+  vector<Quackle::Letter> letters(20000000);
+  for (size_t i = 0; i < letters.size(); ++i) {
+    // one in every alphabet-size letters is the separator
+    const int letter = letterDistribution(rng);
+    letters[i] = letter < QUACKLE_FIRST_LETTER ? QUACKLE_GADDAG_SEPARATOR
+                                                : letter;
+  }
+
+  const int gameCnt = 10;
+  vector<Quackle::GamePosition> positions;
+  for (int i = 0; i < gameCnt; ++i) {
+    Quackle::Game game = makeStaticGame(0);
+
+    while (!game.currentPosition().gameOver()) {
+      positions.push_back(game.currentPosition());
+      game.haveComputerPlay();
+    }
+  }
+
+  vector<Quackle::MoveList> plainMoves;
+  auto start = std::chrono::high_resolution_clock::now();
+  const long plainTerminals = walkGaddag(lexicon->gaddagRoot(), letters);
+  auto end = std::chrono::high_resolution_clock::now();
+  const double plainWalk = std::chrono::duration<double>(end - start).count();
+
+  start = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < positions.size(); ++i) {
+    Quackle::GamePosition position(positions[i]);
+    position.kibitz(40);
+    plainMoves.push_back(position.moves());
+  }
+  end = std::chrono::high_resolution_clock::now();
+  const double plainGenerate =
+      std::chrono::duration<double>(end - start).count();
+
+  start = std::chrono::high_resolution_clock::now();
+  lexicon->setIndexGaddag(true);
+  end = std::chrono::high_resolution_clock::now();
+  const double build = std::chrono::duration<double>(end - start).count();
+
+  start = std::chrono::high_resolution_clock::now();
+  const long indexedTerminals =
+      walkGaddag(lexicon->indexedGaddagRoot(), letters);
+  end = std::chrono::high_resolution_clock::now();
+  const double indexedWalk = std::chrono::duration<double>(end - start).count();
+
+  int mismatches = 0;
+  start = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < positions.size(); ++i) {
+    Quackle::GamePosition position(positions[i]);
+    position.kibitz(40);
+    const Quackle::MoveList &moves = position.moves();
+    if (moves.size() != plainMoves[i].size()) {
+      ++mismatches;
+      continue;
+    }
+    for (size_t j = 0; j < moves.size(); ++j) {
+      if (!(moves[j] == plainMoves[i][j]) ||
+          moves[j].equity != plainMoves[i][j].equity) {
+        ++mismatches;
+        break;
+      }
+    }
+  }
+  end = std::chrono::high_resolution_clock::now();
+  const double indexedGenerate =
+      std::chrono::duration<double>(end - start).count();
+
+  lexicon->setIndexGaddag(wasIndexed);
+
+  if (plainTerminals != indexedTerminals)
+    ++mismatches;
+
+  UVcout << "indexed gaddag: built in " << build << "s; " << letters.size()
+         << " lookups " << plainWalk << "s plain, " << indexedWalk
+         << "s indexed; kibitz of " << positions.size() << " positions "
+         << plainGenerate << "s plain, " << indexedGenerate
+         << "s indexed; " << mismatches << " mismatches" << endl;
+}
+
+// Times copying boards, replaying games onto an empty board and scoring
+// candidate plays, the board operations simulation leans on.
+void benchmarkBoard() {
+  const int gameCnt = 10;
+  vector<Quackle::Board> boards;
+  vector<vector<Quackle::Move>> games;
+  vector<Quackle::Move> candidates;
+  vector<Quackle::Board> candidateBoards;
+
+  for (int i = 0; i < gameCnt; ++i) {
+    Quackle::Game game = makeStaticGame(0);
+
+    games.push_back(vector<Quackle::Move>());
+    while (!game.currentPosition().gameOver()) {
+      Quackle::GamePosition position(game.currentPosition());
+      position.kibitz(20);
+      for (const auto &move : position.moves()) {
+        candidates.push_back(move);
+        candidateBoards.push_back(position.board());
+      }
+      boards.push_back(position.board());
+      games.back().push_back(game.haveComputerPlay());
+    }
+  }
+
+  const int copyRounds = 2000;
+  auto start = std::chrono::high_resolution_clock::now();
+  Quackle::Board copy;
+  long filled = 0;
+  for (int round = 0; round < copyRounds; ++round) {
+    for (const auto &board : boards) {
+      copy = board;
+      filled += copy.letter(7, 7);
+    }
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  const double copying = std::chrono::duration<double>(end - start).count();
+
+  const int replayRounds = 200;
+  start = std::chrono::high_resolution_clock::now();
+  for (int round = 0; round < replayRounds; ++round) {
+    for (const auto &moves : games) {
+      Quackle::Board board;
+      board.prepareEmptyBoard();
+      for (const auto &move : moves)
+        board.makeMove(move);
+      filled += board.isEmpty();
+    }
+  }
+  end = std::chrono::high_resolution_clock::now();
+  const double replaying = std::chrono::duration<double>(end - start).count();
+
+  const int scoreRounds = 50;
+  long scores = 0;
+  start = std::chrono::high_resolution_clock::now();
+  for (int round = 0; round < scoreRounds; ++round) {
+    for (size_t i = 0; i < candidates.size(); ++i)
+      scores += candidateBoards[i].score(candidates[i]);
+  }
+  end = std::chrono::high_resolution_clock::now();
+  const double scoring = std::chrono::duration<double>(end - start).count();
+
+  UVcout << "board: " << copyRounds * boards.size() << " copies "
+         << copying << "s; " << replayRounds * games.size()
+         << " game replays " << replaying << "s; "
+         << scoreRounds * candidates.size() << " scores " << scoring
+         << "s (" << filled + scores << ")" << endl;
+}
@@ -30,6 +30,7 @@ Resolvent::Resolvent()
 {
     m_name = MARK_UV("Resolvent");
     m_id = 201;
+    m_racing = false;
 }
 
 Resolvent::~Resolvent()
@@ -61,7 +62,9 @@ MoveList Resolvent::moves(int nmoves)
     else
     {
         // Case 3: Beginning and middle of the game.
-        delegatee = new SmartBogowin;
+        SmartBogowin *bogowin = new SmartBogowin;
+        bogowin->setRacing(m_racing);
+        delegatee = bogowin;
     }
 
     delegatee->setParameters(parameters());
@@ -96,6 +99,7 @@ TorontoPlayer::TorontoPlayer()
 	m_name = MARK_UV("Championship Player");
 	m_id = 2006;
 	m_parameters.secondsPerTurn = 66;
+	m_racing = true;
 }
 
 TorontoPlayer::~TorontoPlayer()
@@ -107,6 +111,7 @@ FiveMinutePlayer::FiveMinutePlayer()
 	m_name = MARK_UV("Five Minute Championship Player");
 	m_id = 5208;
 	m_parameters.secondsPerTurn = 60 * 5;
+	m_racing = true;
 }
 
 FiveMinutePlayer::~FiveMinutePlayer()
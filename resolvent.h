@@ -37,6 +37,10 @@ public:
 
 	virtual bool isSlow() const;
 	virtual bool isUserVisible() const;
+
+protected:
+	// whether the middle game is simmed by racing the candidates
+	bool m_racing;
 };
 
 inline bool Resolvent::isUserVisible() const
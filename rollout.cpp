@@ -0,0 +1,108 @@
+/*
+ *  Quackle -- Crossword game artificial intelligence and analysis tool
+ *  Copyright (C) 2005-2019 Jason Katz-Brown, John O'Laughlin, and John Fultz.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <climits>
+
+#include "rollout.h"
+
+using namespace Quackle;
+
+const int RolloutPosition::noTilesOnRack = INT_MIN;
+
+RolloutPosition::RolloutPosition()
+{
+}
+
+RolloutPosition::RolloutPosition(const RolloutPosition &other)
+	: m_generator(other.position()), m_facedTilesOnRack(other.m_facedTilesOnRack)
+{
+}
+
+RolloutPosition &RolloutPosition::operator=(const RolloutPosition &other)
+{
+	m_generator.setPosition(other.position());
+	m_facedTilesOnRack = other.m_facedTilesOnRack;
+	return *this;
+}
+
+void RolloutPosition::reset(const Game &game)
+{
+	m_generator.setPosition(game.currentPosition());
+
+	// the history that's left once Game::addClonePosition erases the
+	// positions after the current one
+	const History &history = game.history();
+	const HistoryLocation location(history.currentLocation());
+	PositionList::const_iterator end(history.end());
+	while (end != history.begin())
+	{
+		const GamePosition &last = *(end - 1);
+
+		bool isAfter;
+		if (location.turnNumber() == last.turnNumber())
+			isAfter = location.playerId() < last.playerOnTurn().id();
+		else
+			isAfter = location.turnNumber() < last.turnNumber();
+
+		if (!isAfter)
+			break;
+		--end;
+	}
+
+	m_facedTilesOnRack.assign(position().players().size(), noTilesOnRack);
+	for (PositionList::const_iterator it = history.begin(); it != end; ++it)
+		m_facedTilesOnRack[(*it).playerOnTurn().id()] = (*it).m_tilesOnRack;
+}
+
+Move RolloutPosition::staticBestMove()
+{
+	GamePosition &position = m_generator.position();
+
+	int flags = position.exchangeAllowed()? Generator::RegularKibitz : Generator::CannotExchange;
+	m_generator.kibitz(1, flags | Generator::PruneToBest);
+
+	Move ret(m_generator.kibitzList().back());
+	position.ensureMovePrettiness(ret);
+	return ret;
+}
+
+void RolloutPosition::commitMove(const Move &move, bool maintainBoard)
+{
+	GamePosition &position = m_generator.position();
+	if (position.gameOver())
+		return;
+
+	position.setMoveMade(move);
+	position.prepareForCommit();
+	const Move moveMade(position.moveMade());
+
+	// as Game::addPosition, with this position standing in for the
+	// copy of it Game would keep in the history
+	m_facedTilesOnRack[position.playerOnTurn().id()] = position.m_tilesOnRack;
+	position.incrementTurn(0, &m_facedTilesOnRack);
+	position.removeAllMoves();
+	if (!position.gameOver())
+		position.resetMoveMade();
+
+	// as GamePosition::makeMove, on the generator's board
+	if (!moveMade.isChallengedPhoney())
+		m_generator.makeMove(moveMade, maintainBoard);
+
+	if (moveMade.action == Move::Exchange)
+		position.m_bag.toss(moveMade.usedTiles());
+}
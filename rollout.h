@@ -0,0 +1,81 @@
+/*
+ *  Quackle -- Crossword game artificial intelligence and analysis tool
+ *  Copyright (C) 2005-2019 Jason Katz-Brown, John O'Laughlin, and John Fultz.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QUACKLE_ROLLOUT_H
+#define QUACKLE_ROLLOUT_H
+
+#include <vector>
+
+#include "game.h"
+#include "generator.h"
+
+namespace Quackle
+{
+
+// A game played ahead on just one position, for the simulator. Instead
+// of a history it remembers the one thing incrementTurn needs from
+// one, the tiles on rack of the position each player last faced, so
+// committing a move doesn't copy any positions.
+//
+// The position lives in a generator that is kept from one ply to the
+// next: moves are found on it and made on its board in place, so no
+// generator is made and no position copied per ply. Copying a
+// RolloutPosition copies just the position into the generator, which
+// keeps its storage.
+class RolloutPosition
+{
+public:
+	RolloutPosition();
+	RolloutPosition(const RolloutPosition &other);
+	RolloutPosition &operator=(const RolloutPosition &other);
+
+	// start from the current position of game
+	void reset(const Game &game);
+
+	const GamePosition &position() const;
+	GamePosition &position();
+
+	// as position().staticBestMove()
+	Move staticBestMove();
+
+	// as Game::commitMove(move) followed by play continuing on the
+	// new current position; does nothing if the game is over
+	void commitMove(const Move &move, bool maintainBoard = true);
+
+	static const int noTilesOnRack;
+
+private:
+	Generator m_generator;
+
+	// by player id, or noTilesOnRack if they've faced no position
+	std::vector<int> m_facedTilesOnRack;
+};
+
+inline const GamePosition &RolloutPosition::position() const
+{
+	return m_generator.position();
+}
+
+inline GamePosition &RolloutPosition::position()
+{
+	return m_generator.position();
+}
+
+}
+
+#endif
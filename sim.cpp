@@ -16,9 +16,27 @@
  *  along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <math.h>
+#include <random>
+#include <sstream>
+#include <type_traits>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
+#include "clock.h"
 #include "computerplayer.h"
 #include "datamanager.h"
 #include "game.h"
@@ -36,8 +54,9 @@ using namespace std;
 std::atomic_long SimmedMove::objectIdCounter{0};
 
 Simulator::Simulator()
-    : m_logfileIsOpen(false), m_hasHeader(false), m_dispatch(0),
-      m_iterations(0), m_ignoreOppos(false) {
+    : m_hasHeader(false), m_traceOrder(0), m_dispatch(0),
+      m_iterations(0), m_ignoreOppos(false), m_commonRandomNumbers(false),
+      m_scenarioSeed(0) {
   m_originalGame.addPosition();
   setThreadCount(2);
 }
@@ -58,6 +77,9 @@ void Simulator::setPosition(const GamePosition &position) {
   for (const auto &it : m_originalGame.currentPosition().moves())
     m_simmedMoves.push_back(SimmedMove(it));
 
+  // chosen when the first scenario is set up
+  m_scenarioSeed = 0;
+
   resetNumbers();
 }
 
@@ -73,20 +95,12 @@ void Simulator::setLogfile(const string &logfile, bool append) {
     return;
   }
 
-  const ios::openmode flags = append ? (ios::out | ios::app) : ios::out;
-  m_logfileStream.open(m_logfile.c_str(), flags);
-
-  m_logfileIsOpen = m_logfileStream.is_open();
-  if (!m_logfileIsOpen)
+  if (!m_trace.open(m_logfile, append, m_scheduler.workerCount()))
     cerr << "Could not open " << m_logfile << " to write simulation log"
          << endl;
 
   m_hasHeader = false;
-}
-
-void Simulator::logMessage(const UVString &message) {
-  if (isLogging())
-    m_logfileStream << message << endl;
+  m_traceOrder = 0;
 }
 
 void Simulator::closeLogfile() {
@@ -94,15 +108,16 @@ void Simulator::closeLogfile() {
     if (m_hasHeader)
       writeLogFooter();
 
-    m_logfileStream.close();
-    m_logfileIsOpen = false;
+    m_trace.close();
   }
 }
 
 void Simulator::writeLogHeader() {
   if (isLogging()) {
-    m_logfileStream << "<simulation>" << endl;
-    m_xmlIndent = MARK_UV("\t");
+    SimTraceRecord record;
+    record.type = SimTraceRecord::SimulationStart;
+    record.order = m_traceOrder;
+    m_trace.write(traceWorker(), record);
 
     m_hasHeader = true;
 
@@ -112,13 +127,21 @@ void Simulator::writeLogHeader() {
 
 void Simulator::writeLogFooter() {
   if (isLogging()) {
-    m_xmlIndent = MARK_UV("");
-    m_logfileStream << "</simulation>" << endl;
+    // after the last iteration started
+    SimTraceRecord record;
+    record.type = SimTraceRecord::SimulationEnd;
+    record.order = m_traceOrder - 1;
+    m_trace.write(traceWorker(), record);
 
     m_hasHeader = false;
   }
 }
 
+size_t Simulator::traceWorker() const {
+  // the last worker is whoever waits on the threads
+  return m_scheduler.workerCount() - 1;
+}
+
 void Simulator::setDispatch(ComputerDispatch *dispatch) {
   m_dispatch = dispatch;
 }
@@ -173,75 +196,374 @@ bool Simulator::isConsideredMove(const Move &move) const {
 void Simulator::pruneTo(double equityThreshold, int maxNumberOfMoves) {
   MoveList equityMoves(moves(/* prune unincluded */ true));
   MoveList toSetIncluded;
-  const double absoluteEquityThreshold =
-      equityMoves[0].equity - equityThreshold;
+  const SimmedMove &leader = simmedMoveForMove(equityMoves[0]);
 
   const MoveList::const_iterator end = equityMoves.end();
   int i = 0;
   for (MoveList::const_iterator it = equityMoves.begin();
        i < maxNumberOfMoves && it != end; ++it, ++i) {
-    if ((*it).equity >= absoluteEquityThreshold)
+    double behind = equityMoves[0].equity - (*it).equity;
+    if (m_commonRandomNumbers) {
+      const AveragedValue difference =
+          simmedMoveForMove(*it).pairedDifference(leader);
+      if (difference.hasValues())
+        behind = -difference.averagedValue();
+    }
+
+    if (behind <= equityThreshold)
       toSetIncluded.push_back(*it);
   }
 
   setIncludedMoves(toSetIncluded);
 }
 
+// half the width of value's 95% confidence interval
+static double confidenceRadius(const AveragedValue &value) {
+  return 1.96 * value.standardDeviation() /
+         sqrt((double)value.incorporatedValues());
+}
+
+void Simulator::pruneClearlyWorse(bool byWin) {
+  const MoveList ranked(moves(/* prune unincluded */ true, byWin));
+  if (ranked.size() < 2)
+    return;
+
+  const SimmedMove &leader = simmedMoveForMove(ranked.front());
+  const AveragedValue leaderValues = leader.playaheadValues(byWin);
+  if (leaderValues.incorporatedValues() < 2)
+    return;
+  const double leaderBottom =
+      leaderValues.averagedValue() - confidenceRadius(leaderValues);
+
+  MoveList toSetIncluded;
+  for (const auto &move : ranked) {
+    const SimmedMove &simmedMove = simmedMoveForMove(move);
+
+    bool clearlyWorse = false;
+    if (&simmedMove == &leader || isConsideredMove(move)) {
+      clearlyWorse = false;
+    } else if (m_commonRandomNumbers) {
+      const AveragedValue difference =
+          simmedMove.pairedDifference(leader, byWin);
+      clearlyWorse = difference.incorporatedValues() > 1 &&
+                     difference.averagedValue() +
+                             confidenceRadius(difference) <
+                         0;
+    } else {
+      const AveragedValue values = simmedMove.playaheadValues(byWin);
+      clearlyWorse =
+          values.incorporatedValues() > 1 &&
+          values.averagedValue() + confidenceRadius(values) < leaderBottom;
+    }
+
+    if (!clearlyWorse)
+      toSetIncluded.push_back(move);
+  }
+
+  setIncludedMoves(toSetIncluded);
+}
+
 void Simulator::resetNumbers() {
   for (auto &moveIt : m_simmedMoves)
     moveIt.clear();
+  m_accumulator.reset(0, 0, 0, 0);
 
   m_iterations = 0;
 }
 
-void Simulator::simThreadFunc(SimmedMoveMessageQueue &incoming,
-                              SimmedMoveMessageQueue &outgoing) {
+void Simulator::setThreadCount(size_t count) {
+  m_scheduler.setThreadCount(count);
+  m_trace.setWorkerCount(m_scheduler.workerCount());
+}
+
+void Simulator::simulate(int plies, int iterations) {
+  prepareAccumulator(plies);
+
+  // Keep a few iterations per thread in flight, so threads that finish
+  // their share of one iteration move on to the next rather than wait.
+  const size_t window = 2 * (m_scheduler.threadCount() + 1);
+  std::deque<std::unique_ptr<SimmedIteration>> inFlight;
+
+  int started = 0;
   while (true) {
-    auto result = incoming.pop_or_terminate();
-    if (result.second)
+    while (started < iterations && inFlight.size() < window) {
+      if (m_dispatch && m_dispatch->shouldAbort()) {
+        iterations = started;
+        break;
+      }
+      inFlight.push_back(startIteration(plies));
+      ++started;
+    }
+
+    if (inFlight.empty())
       break;
-    Simulator::simulateOnePosition(result.first, incoming.constants());
-    outgoing.push(result.first);
+
+    finishIteration(*inFlight.front());
+    inFlight.pop_front();
   }
 }
 
-void Simulator::setThreadCount(size_t count) {
-  if (count == 0 && m_threadPool.size() != 0) {
-    m_sendQueue.send_terminate_all();
-    for (auto &t : m_threadPool)
-      t.join();
-    m_threadPool.clear();
+void Simulator::simulate(int plies) { simulate(plies, 1); }
+
+void Simulator::prepareAccumulator(int plies) {
+  // the same levels as startIteration lays out
+  if (plies < 0)
+    plies = 1000;
+  ++plies;
+  const int players = int(m_originalGame.currentPosition().players().size());
+  const int levels = (plies - plies % players) / players + 1;
+
+  const size_t workers = m_scheduler.workerCount();
+  if (!m_accumulator.fits(workers, m_simmedMoves.size(), levels, players)) {
+    incorporateAccumulated();
+    m_accumulator.reset(workers, m_simmedMoves.size(), levels, players);
   }
 
-  while (count > m_threadPool.size()) {
-    m_threadPool.emplace_back(Simulator::simThreadFunc, std::ref(m_sendQueue),
-                              std::ref(m_receiveQueue));
+  // only common random numbers pair playaheads up
+  m_accumulator.setRecordPlayaheads(m_commonRandomNumbers);
+}
+
+void Simulator::incorporateAccumulated() const {
+  m_accumulator.incorporateInto(m_simmedMoves);
+}
+
+int Simulator::race(int plies, int maxIterations, int maxSeconds,
+                    bool byWin) {
+  // enough playaheads between prunings for the intervals to mean
+  // something, few enough that losers don't use up much time
+  const int batchIterations = 16;
+
+  Stopwatch stopwatch;
+  int iterationsRun = 0;
+
+  while (iterationsRun < maxIterations) {
+    if (m_dispatch && m_dispatch->shouldAbort())
+      break;
+    if (maxSeconds > 0 && stopwatch.exceeded(maxSeconds))
+      break;
+    if (moves(/* prune */ true).size() < 2)
+      break;
+
+    const int batch = std::min(batchIterations, maxIterations - iterationsRun);
+    const int before = m_iterations;
+    simulate(plies, batch);
+    iterationsRun += m_iterations - before;
+
+    pruneClearlyWorse(byWin);
+
+    if (m_dispatch) {
+      double done = (double)iterationsRun / maxIterations;
+      if (maxSeconds > 0)
+        done = std::max(done, (double)stopwatch.elapsed() / maxSeconds);
+      m_dispatch->signalFractionDone(std::min(done, 1.0));
+    }
   }
 
-  while (count < m_threadPool.size()) {
-    m_sendQueue.send_terminate_one(m_threadPool.back().get_id());
-    m_threadPool.back().join();
-    m_threadPool.pop_back();
+  return iterationsRun;
+}
+
+#if !defined(_WIN32)
+static bool writeAll(int fd, const string &data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    const ssize_t count =
+        ::write(fd, data.data() + written, data.size() - written);
+    if (count < 0 && errno == EINTR)
+      continue;
+    if (count <= 0)
+      return false;
+    written += count;
   }
+  return true;
 }
 
-void Simulator::simulate(int plies, int iterations) {
-  for (int i = 0; i < iterations; ++i) {
-    if (m_dispatch && m_dispatch->shouldAbort())
+// read what fd has ready onto data; false once it's closed or fails
+static bool readAvailable(int fd, string &data) {
+  char buffer[65536];
+  const ssize_t count = ::read(fd, buffer, sizeof(buffer));
+  if (count < 0 && errno == EINTR)
+    return true;
+  if (count <= 0)
+    return false;
+  data.append(buffer, count);
+  return true;
+}
+#endif
+
+bool Simulator::runShard(int socket, const vector<unsigned> &seed, int plies,
+                         int iterations, size_t threads) const {
+#if defined(_WIN32)
+  return false;
+#else
+  std::seed_seq seedSequence(seed.begin(), seed.end());
+  DataManager::self()->seedRandomNumbers(seedSequence);
+
+  Simulator shard;
+  shard.setThreadCount(threads);
+  shard.setPosition(currentPosition());
+  shard.setIncludedMoves(moves(/* prune */ true));
+  shard.setPartialOppoRack(m_partialOppoRack);
+  shard.setIgnoreOppos(m_ignoreOppos);
+  shard.setCommonRandomNumbers(m_commonRandomNumbers);
+  shard.simulate(plies, iterations);
+
+  ostringstream checkpoint;
+  return shard.saveCheckpoint(checkpoint) &&
+         writeAll(socket, checkpoint.str());
+#endif
+}
+
+void Simulator::simulateSharded(int plies, int iterations, int shards) {
+#if !defined(_WIN32)
+  if (shards <= 1) {
+    simulate(plies, iterations);
+    return;
+  }
+
+  struct Shard {
+    pid_t pid;
+    int socket;
+    int iterations;
+  };
+  vector<Shard> running;
+
+  // every shard's stream starts from these and its number
+  const unsigned seedHigh = DataManager::self()->randomInteger(0, 0x7fffffff);
+  const unsigned seedLow = DataManager::self()->randomInteger(0, 0x7fffffff);
+
+  // what's buffered would be written again by every process
+  UVcout.flush();
+  cout.flush();
+
+  // A forked process has only the thread that forked it, and a lock
+  // another thread held at the time is never released there, so our
+  // threads and the trace writer's stop first and start again once
+  // the shards are forked.
+  const size_t threads = m_scheduler.threadCount();
+  const bool logging = isLogging();
+  if (logging)
+    m_trace.close();
+  setThreadCount(0);
+
+  int unsharded = iterations;
+  for (int i = 0; i < shards; ++i) {
+    const int share = iterations / shards + (i < iterations % shards ? 1 : 0);
+    if (share == 0)
+      continue;
+
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+      cerr << "Could not open a socket to a simulation shard" << endl;
       break;
-    simulate(plies);
+    }
+
+    const pid_t pid = fork();
+    if (pid == 0) {
+      close(sockets[0]);
+      const bool sent = runShard(sockets[1], {seedHigh, seedLow, unsigned(i)},
+                                 plies, share, threads);
+      _exit(sent ? 0 : 1);
+    }
+
+    close(sockets[1]);
+    if (pid < 0) {
+      close(sockets[0]);
+      cerr << "Could not start a simulation shard" << endl;
+      break;
+    }
+
+    running.push_back({pid, sockets[0], share});
+    unsharded -= share;
   }
+
+  setThreadCount(threads);
+  if (logging && !m_trace.open(m_logfile, true, m_scheduler.workerCount()))
+    cerr << "Could not open " << m_logfile << " to write simulation log"
+         << endl;
+
+  // read what the shards send as it comes, looking out for an abort
+  vector<string> received(running.size());
+  vector<bool> reading(running.size(), true);
+  size_t stillReading = running.size();
+  bool aborted = false;
+  while (stillReading > 0) {
+    if (m_dispatch && m_dispatch->shouldAbort()) {
+      aborted = true;
+      break;
+    }
+
+    vector<pollfd> sockets;
+    vector<size_t> shardOfSocket;
+    for (size_t i = 0; i < running.size(); ++i) {
+      if (reading[i]) {
+        sockets.push_back({running[i].socket, POLLIN, 0});
+        shardOfSocket.push_back(i);
+      }
+    }
+
+    if (poll(sockets.data(), sockets.size(), 100) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    for (size_t j = 0; j < sockets.size(); ++j) {
+      const size_t i = shardOfSocket[j];
+      if (sockets[j].revents && !readAvailable(sockets[j].fd, received[i])) {
+        reading[i] = false;
+        --stillReading;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < running.size(); ++i) {
+    const Shard &shard = running[i];
+    // a shard still sending is no longer wanted
+    if (reading[i])
+      kill(shard.pid, SIGKILL);
+    close(shard.socket);
+
+    int status = 0;
+    while (waitpid(shard.pid, &status, 0) < 0 && errno == EINTR)
+      ;
+
+    if (aborted)
+      continue;
+
+    istringstream checkpoint(received[i]);
+    if (reading[i] || !WIFEXITED(status) || WEXITSTATUS(status) != 0 ||
+        !mergeCheckpoint(checkpoint, "simulation shard")) {
+      cerr << "Simulation shard " << shard.pid << " failed; running its "
+           << shard.iterations << " iterations here" << endl;
+      unsharded += shard.iterations;
+    }
+  }
+
+  iterations = unsharded;
+#endif
+
+  simulate(plies, iterations);
 }
 
-void Simulator::simulate(int plies) {
+std::unique_ptr<Simulator::SimmedIteration>
+Simulator::startIteration(int plies) {
 #ifdef DEBUG_SIM
   UVcout << "let's simulate for " << plies << " plies" << endl;
 #endif
 
-  ++m_iterations;
-
-  randomizeOppoRacks();
-  randomizeDrawingOrder();
+  std::unique_ptr<SimmedIteration> iteration(new SimmedIteration);
+  iteration->index = ++m_iterations;
+  iteration->traceOrder = m_traceOrder;
+
+  if (!m_commonRandomNumbers) {
+    randomizeOppoRacks();
+    randomizeDrawingOrder();
+  } else if (m_scenarioSeed == 0) {
+    m_scenarioSeed =
+        (std::uint64_t(DataManager::self()->randomInteger(1, 0x7fffffff))
+         << 32) |
+        std::uint64_t(DataManager::self()->randomInteger(0, 0x7fffffff));
+  }
 
   if (plies < 0)
     plies = 1000;
@@ -250,7 +572,7 @@ void Simulator::simulate(int plies) {
   ++plies;
 
   SimmedMoveConstants constants;
-  constants.game = m_originalGame;
+  constants.start.reset(m_originalGame);
   constants.startPlayerId =
       m_originalGame.currentPosition().currentPlayer().id();
   constants.playerCount =
@@ -261,62 +583,119 @@ void Simulator::simulate(int plies) {
   constants.levelCount =
       (int)((plies - constants.decimalTurns) / constants.playerCount);
   constants.ignoreOppos = m_ignoreOppos;
-  constants.isLogging = isLogging();
+  constants.trace = isLogging() ? &m_trace : nullptr;
 
-  m_sendQueue.setConstants(constants);
-
-  if (isLogging()) {
-    if (!m_hasHeader)
-      writeLogHeader();
+  // without common random numbers every candidate starts from the same
+  // position; with them, each candidate's scenario is set up once
+  std::map<int, const SimmedMoveConstants *> scenarios;
+  if (!m_commonRandomNumbers)
+    iteration->constants.push_back(constants);
 
-    m_logfileStream << m_xmlIndent << "<iteration index=\"" << m_iterations
-                    << "\">" << endl;
-    m_xmlIndent += MARK_UV('\t');
-  }
+  if (isLogging() && !m_hasHeader)
+    writeLogHeader();
 
   int messageCount = 0;
+  for (const auto &moveIt : m_simmedMoves)
+    if (moveIt.includeInSimulation())
+      ++messageCount;
 
-  for (auto &moveIt : m_simmedMoves) {
+  iteration->messages.resize(messageCount);
+  iteration->remaining = messageCount;
+
+  vector<SimmedMoveTask> tasks;
+  tasks.reserve(messageCount);
+
+  int messageIndex = 0;
+  for (size_t candidate = 0; candidate < m_simmedMoves.size(); ++candidate) {
+    SimmedMove &moveIt = m_simmedMoves[candidate];
     if (!moveIt.includeInSimulation())
       continue;
 
 #ifdef DEBUG_SIM
-    UVcout << "simulating " << (*moveIt).move << ":" << endl;
+    UVcout << "simulating " << moveIt.move << ":" << endl;
 #endif
 
     moveIt.levels.setNumberLevels(constants.levelCount + 1);
 
-    SimmedMoveMessage message;
+    SimmedMoveMessage &message = iteration->messages[messageIndex++];
     message.id = moveIt.id();
     message.move = moveIt.move;
     message.levels.setNumberLevels(constants.levelCount + 1);
-    message.levels = moveIt.levels;
-    message.xmlIndent = m_xmlIndent;
+    message.iteration = iteration->index;
+    message.traceOrder = m_traceOrder;
+    message.index = messageIndex - 1;
+
+    const int scenario = moveIt.startedPlayaheads++;
+    message.scenario = scenario;
+    const SimmedMoveConstants *start = &iteration->constants.front();
+    if (m_commonRandomNumbers) {
+      const auto found = scenarios.find(scenario);
+      if (found != scenarios.end()) {
+        start = found->second;
+      } else {
+        iteration->constants.push_back(constants);
+        setUpScenario(scenario, iteration->constants.back().start);
+        start = scenarios[scenario] = &iteration->constants.back();
+      }
+    }
 
-    m_sendQueue.push(message);
-    messageCount++;
+    SimmedMoveTask task;
+    task.message = &message;
+    task.constants = start;
+    task.remaining = &iteration->remaining;
+    task.accumulator = &m_accumulator;
+    task.candidate = candidate;
+    tasks.push_back(task);
   }
 
-  while (messageCount-- > 0) {
-    SimmedMoveMessage message(m_receiveQueue.pop());
-    incorporateMessage(message);
-  }
+  if (isLogging())
+    ++m_traceOrder;
+
+  m_scheduler.pushBatch(tasks);
+  return iteration;
+}
+
+void Simulator::finishIteration(SimmedIteration &iteration) {
+  // the threads have added the messages to the accumulator and
+  // queued their trace records already
+  m_scheduler.waitFor(iteration.remaining);
 
   if (isLogging()) {
-    m_xmlIndent = m_xmlIndent.substr(0, m_xmlIndent.length() - 1);
-    m_logfileStream << m_xmlIndent << "</iteration>" << endl;
+    SimTraceRecord record;
+    record.type = SimTraceRecord::IterationEnd;
+    record.order = iteration.traceOrder;
+    m_trace.write(traceWorker(), record);
   }
 }
 
+// a trace record of type for message's playahead
+static SimTraceRecord traceRecord(SimTraceRecord::Type type,
+                                  const SimmedMoveMessage &message) {
+  SimTraceRecord record;
+  record.type = type;
+  record.order = message.traceOrder;
+  record.iteration = message.iteration;
+  record.candidate = message.index;
+  record.candidateId = message.id;
+  return record;
+}
+
 void Simulator::simulateOnePosition(SimmedMoveMessage &message,
-                                    const SimmedMoveConstants &constants) {
-  Game game = constants.game;
+                                    const SimmedMoveConstants &constants,
+                                    size_t worker) {
+  // each thread plays ahead on its own copy of the start, which keeps
+  // its storage from one playahead to the next
+  static thread_local RolloutPosition rollout;
+  rollout = constants.start;
+  GamePosition &position = rollout.position();
   double residual = 0;
+  double equity = 0;
+  SimTraceRecord record;
 
   int levelNumber = 1;
   for (LevelList::iterator levelIt = message.levels.begin();
        levelNumber <= constants.levelCount + 1 &&
-       levelIt != message.levels.end() && !game.currentPosition().gameOver();
+       levelIt != message.levels.end() && !position.gameOver();
        ++levelIt, ++levelNumber) {
     const int decimal = levelNumber == constants.levelCount + 1
                             ? constants.decimalTurns
@@ -328,18 +707,10 @@ void Simulator::simulateOnePosition(SimmedMoveMessage &message,
 
     int playerNumber = 0;
     for (auto &scoresIt : (*levelIt).statistics) {
-      if (game.currentPosition().gameOver())
+      if (position.gameOver())
         break;
       ++playerNumber;
-      const int playerId = game.currentPosition().currentPlayer().id();
-
-      if (constants.isLogging) {
-        message.logStream << message.xmlIndent << "<ply index=\""
-                          << (levelNumber - 1) * constants.playerCount +
-                                 playerNumber - 1
-                          << "\">" << endl;
-        message.xmlIndent += MARK_UV('\t');
-      }
+      const int playerId = position.currentPlayer().id();
 
       Move move = Move::createNonmove();
 
@@ -348,12 +719,12 @@ void Simulator::simulateOnePosition(SimmedMoveMessage &message,
       else if (constants.ignoreOppos && playerId != constants.startPlayerId)
         move = Move::createPassMove();
       else
-        move = game.currentPosition().staticBestMove();
+        move = rollout.staticBestMove();
 
       int deadwoodScore = 0;
-      if (game.currentPosition().doesMoveEndGame(move)) {
+      if (position.doesMoveEndGame(move)) {
         LetterString deadwood;
-        deadwoodScore = game.currentPosition().deadwood(&deadwood);
+        deadwoodScore = position.deadwood(&deadwood);
         // account for deadwood in this move rather than a separate
         // UnusedTilesBonus move.
         move.score += deadwoodScore;
@@ -361,12 +732,18 @@ void Simulator::simulateOnePosition(SimmedMoveMessage &message,
 
       scoresIt.score.incorporateValue(move.score);
       scoresIt.bingos.incorporateValue(move.isBingo ? 1.0 : 0.0);
-
-      if (constants.isLogging) {
-        message.logStream << message.xmlIndent
-                          << game.currentPosition().currentPlayer().rack().xml()
-                          << endl;
-        message.logStream << message.xmlIndent << move.xml() << endl;
+      equity += playerNumber == 1 ? move.score : -move.score;
+
+      if (constants.trace) {
+        record = traceRecord(SimTraceRecord::Ply, message);
+        record.ply =
+            (levelNumber - 1) * constants.playerCount + playerNumber - 1;
+        const LetterString &rack = position.currentPlayer().rack().tiles();
+        record.rackLength = (unsigned char)std::min<int>(
+            rack.length(), SimTraceRecord::MaximumRackLength);
+        std::copy(rack.begin(), rack.begin() + record.rackLength,
+                  record.rack);
+        record.move = PackedMove(move);
       }
 
       // record future-looking residuals
@@ -387,23 +764,22 @@ void Simulator::simulateOnePosition(SimmedMoveMessage &message,
 
       if (isFinalTurnForPlayerOfSimulation &&
           !(constants.ignoreOppos && playerId != constants.startPlayerId)) {
-        double residualAddend =
-            game.currentPosition().calculatePlayerConsideration(move);
-        if (constants.isLogging)
-          message.logStream << message.xmlIndent << "<pc value=\""
-                            << residualAddend << "\" />" << endl;
+        double residualAddend = position.calculatePlayerConsideration(move);
+        record.flags |= SimTraceRecord::HasPlayerConsideration;
+        record.value = residualAddend;
 
         if (isVeryFinalTurnOfSimulation) {
           // experimental -- do shared resource considerations
           // matter in a plied simulation?
 
           const double sharedResidual =
-              game.currentPosition().calculateSharedConsideration(move);
+              position.calculateSharedConsideration(move);
           residualAddend += sharedResidual;
 
-          if (constants.isLogging && sharedResidual != 0)
-            message.logStream << message.xmlIndent << "<sc value=\""
-                              << sharedResidual << "\" />" << endl;
+          if (sharedResidual != 0) {
+            record.flags |= SimTraceRecord::HasSharedConsideration;
+            record.sharedConsideration = sharedResidual;
+          }
         }
 
         if (playerId == constants.startPlayerId)
@@ -415,63 +791,55 @@ void Simulator::simulateOnePosition(SimmedMoveMessage &message,
       // committing the move will account for deadwood again
       // so avoid double counting from above.
       move.score -= deadwoodScore;
-      game.setCandidate(move);
-
-      game.commitCandidate(!isVeryFinalTurnOfSimulation);
+      rollout.commitMove(move, !isVeryFinalTurnOfSimulation);
 
-      if (constants.isLogging) {
-        message.xmlIndent =
-            message.xmlIndent.substr(0, message.xmlIndent.length() - 1);
-        message.logStream << message.xmlIndent << "</ply>" << endl;
-      }
+      if (constants.trace)
+        constants.trace->write(worker, record);
     }
   }
 
   message.residual = residual;
-  int spread = game.currentPosition().spread(constants.startPlayerId);
+  message.equity = equity + residual;
+  int spread = position.spread(constants.startPlayerId);
   message.gameSpread = spread;
 
-  if (game.currentPosition().gameOver()) {
+  if (position.gameOver()) {
     message.bogowin = false;
     message.wins = spread > 0 ? 1 : spread == 0 ? 0.5 : 0;
   } else {
     message.bogowin = true;
-    if (game.currentPosition().currentPlayer().id() == constants.startPlayerId)
+    if (position.currentPlayer().id() == constants.startPlayerId)
       message.wins = QUACKLE_STRATEGY_PARAMETERS->bogowin(
           (int)(spread + residual),
-          game.currentPosition().bag().size() + QUACKLE_PARAMETERS->rackSize(),
-          0);
+          position.bag().size() + QUACKLE_PARAMETERS->rackSize(), 0);
     else
       message.wins = 1.0 - QUACKLE_STRATEGY_PARAMETERS->bogowin(
                                (int)(-spread - residual),
-                               game.currentPosition().bag().size() +
+                               position.bag().size() +
                                    QUACKLE_PARAMETERS->rackSize(),
                                0);
   }
+
+  if (constants.trace) {
+    record = traceRecord(SimTraceRecord::Playahead, message);
+    if (!message.bogowin) {
+      record.flags |= SimTraceRecord::GameOver;
+      record.value = message.wins;
+    }
+    constants.trace->write(worker, record);
+  }
 }
 
 void Simulator::incorporateMessage(const SimmedMoveMessage &message) {
-  if (isLogging())
-    m_logfileStream << message.logStream.str();
   for (auto &moveIt : m_simmedMoves) {
     if (moveIt.id() == message.id) {
-      if (isLogging()) {
-        m_logfileStream << m_xmlIndent << "<playahead>" << endl;
-        m_xmlIndent += MARK_UV('\t');
-      }
-
-      moveIt.levels = message.levels;
+      moveIt.levels.incorporateLevels(message.levels);
       moveIt.residual.incorporateValue(message.residual);
       moveIt.gameSpread.incorporateValue(message.gameSpread);
       moveIt.wins.incorporateValue(message.wins);
-
-      if (isLogging()) {
-        if (!message.bogowin)
-          m_logfileStream << m_xmlIndent << "<gameover win=\"" << message.wins
-                          << "\" />" << endl;
-        m_xmlIndent = m_xmlIndent.substr(0, m_xmlIndent.length() - 1);
-        m_logfileStream << m_xmlIndent << "</playahead>" << endl;
-      }
+      moveIt.playaheadEquity.incorporateValue(message.equity);
+      if (m_commonRandomNumbers)
+        moveIt.playaheads.push_back({message.equity, message.wins});
       break;
     }
   }
@@ -518,7 +886,40 @@ void Simulator::randomizeDrawingOrder() {
       m_originalGame.currentPosition().bag().someShuffledTiles());
 }
 
+void Simulator::setUpScenario(int scenario, RolloutPosition &start) const {
+  GamePosition &position = start.position();
+
+  // the same tiles in the same order for every candidate, whatever
+  // order the bag happens to be in
+  LongLetterString tiles(position.unseenBag().tiles());
+  std::sort(tiles.begin(), tiles.end());
+
+  std::seed_seq seed{unsigned(m_scenarioSeed >> 32),
+                     unsigned(m_scenarioSeed & 0xffffffff), unsigned(scenario)};
+  std::mt19937_64 rng(seed);
+  std::shuffle(tiles.begin(), tiles.end(), rng);
+
+  Bag bag;
+  bag.clear();
+  bag.toss(tiles);
+  bag.setDrawInOrder(true);
+
+  for (const auto &it : position.players()) {
+    if (it == position.currentPlayer())
+      continue;
+
+    Rack rack = m_partialOppoRack;
+    bag.removeLetters(rack.tiles());
+    bag.refill(rack);
+    position.setPlayerRack(it.id(), rack, /* adjust bag */ false);
+  }
+
+  position.setBag(bag);
+  position.setDrawingOrder(LetterString());
+}
+
 MoveList Simulator::moves(bool prune, bool byWin) const {
+  incorporateAccumulated();
   MoveList ret;
 
   const bool useCalculatedEquity = hasSimulationResults();
@@ -546,6 +947,7 @@ MoveList Simulator::moves(bool prune, bool byWin) const {
 }
 
 const SimmedMove &Simulator::simmedMoveForMove(const Move &move) const {
+  incorporateAccumulated();
   for (const auto &it : m_simmedMoves)
     if (it.move == move)
       return it;
@@ -553,18 +955,391 @@ const SimmedMove &Simulator::simmedMoveForMove(const Move &move) const {
   return m_simmedMoves.back();
 }
 
+AveragedValue Simulator::pairedDifference(const Move &move, bool byWin) const {
+  const MoveList ranked(moves(/* prune */ true, byWin));
+  if (ranked.empty())
+    return AveragedValue();
+  return simmedMoveForMove(move).pairedDifference(
+      simmedMoveForMove(ranked.front()), byWin);
+}
+
 int Simulator::numLevels() const {
+  incorporateAccumulated();
   if (m_simmedMoves.empty())
     return 0;
   return int(m_simmedMoves.front().levels.size());
 }
 
 int Simulator::numPlayersAtLevel(int levelIndex) const {
+  incorporateAccumulated();
   if (m_simmedMoves.empty())
     return 0;
   return int(m_simmedMoves.front().levels[levelIndex].statistics.size());
 }
 
+// Checkpoints are a header and then each simmed move with its numbers,
+// field by field in little-endian order, so that one written on any
+// machine can be read on any other.
+
+static const char checkpointMagic[16] = "quacklesimckpt";
+static const std::uint32_t checkpointVersion = 3;
+
+static_assert(std::numeric_limits<double>::is_iec559,
+              "checkpoints hold doubles in IEEE 754 form");
+
+template <typename T> static void writeField(ostream &stream, T value) {
+  static_assert(std::is_integral<T>::value, "fields are fixed-width");
+  typedef typename std::make_unsigned<T>::type Bits;
+  const Bits bits = Bits(value);
+  for (size_t i = 0; i < sizeof(bits); ++i)
+    stream.put(char((bits >> (8 * i)) & 0xff));
+}
+
+static void writeField(ostream &stream, double value) {
+  std::uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  writeField(stream, bits);
+}
+
+template <typename T> static bool readField(istream &stream, T &value) {
+  static_assert(std::is_integral<T>::value, "fields are fixed-width");
+  typedef typename std::make_unsigned<T>::type Bits;
+  unsigned char bytes[sizeof(Bits)];
+  if (!stream.read(reinterpret_cast<char *>(bytes), sizeof(bytes)))
+    return false;
+  Bits bits = 0;
+  for (size_t i = 0; i < sizeof(bits); ++i)
+    bits |= Bits(Bits(bytes[i]) << (8 * i));
+  value = T(bits);
+  return true;
+}
+
+static bool readField(istream &stream, double &value) {
+  std::uint64_t bits;
+  if (!readField(stream, bits))
+    return false;
+  memcpy(&value, &bits, sizeof(value));
+  return true;
+}
+
+// the sums are kept as long doubles, whose size varies, but saved as
+// doubles
+static void writeValue(ostream &stream, const AveragedValue &value) {
+  writeField(stream, double(value.valueSum()));
+  writeField(stream, double(value.squaredValueSum()));
+  writeField(stream, std::int64_t(value.incorporatedValues()));
+}
+
+static bool readValue(istream &stream, AveragedValue &value) {
+  double valueSum;
+  double squaredValueSum;
+  std::int64_t incorporatedValues;
+  if (!readField(stream, valueSum) || !readField(stream, squaredValueSum) ||
+      !readField(stream, incorporatedValues))
+    return false;
+  value = AveragedValue(valueSum, squaredValueSum, long(incorporatedValues));
+  return true;
+}
+
+static void writeLetters(ostream &stream, const LetterString &letters) {
+  writeField(stream, std::uint8_t(letters.length()));
+  stream.write((const char *)letters.constData(), letters.length());
+}
+
+static bool readLetters(istream &stream, LetterString &letters) {
+  std::uint8_t length;
+  char buffer[FIXED_STRING_MAXIMUM_LENGTH];
+  if (!readField(stream, length) || length > FIXED_STRING_MAXIMUM_LENGTH ||
+      !stream.read(buffer, length))
+    return false;
+  letters = LetterString(buffer, length);
+  return true;
+}
+
+static void writeMove(ostream &stream, const Move &move) {
+  writeField(stream, std::uint8_t(move.action));
+  writeField(stream, std::uint8_t(move.horizontal));
+  writeField(stream, std::int32_t(move.startrow));
+  writeField(stream, std::int32_t(move.startcol));
+  writeLetters(stream, move.tiles());
+  writeLetters(stream, move.prettyTiles());
+  writeField(stream, std::int32_t(move.score));
+  writeField(stream, std::uint8_t(move.isBingo));
+  writeField(stream, move.equity);
+  writeField(stream, move.win);
+  writeField(stream, move.possibleWin);
+  writeField(stream, std::int32_t(move.scoreAddition()));
+  writeField(stream, std::uint8_t(move.isChallengedPhoney()));
+}
+
+static bool readMove(istream &stream, Move &move) {
+  std::uint8_t action;
+  std::uint8_t horizontal;
+  std::int32_t startrow;
+  std::int32_t startcol;
+  LetterString tiles;
+  LetterString prettyTiles;
+  std::int32_t score;
+  std::uint8_t isBingo;
+  std::int32_t scoreAddition;
+  std::uint8_t challengedPhoney;
+  if (!readField(stream, action) || !readField(stream, horizontal) ||
+      !readField(stream, startrow) || !readField(stream, startcol) ||
+      !readLetters(stream, tiles) || !readLetters(stream, prettyTiles) ||
+      !readField(stream, score) || !readField(stream, isBingo) ||
+      !readField(stream, move.equity) || !readField(stream, move.win) ||
+      !readField(stream, move.possibleWin) ||
+      !readField(stream, scoreAddition) ||
+      !readField(stream, challengedPhoney))
+    return false;
+  move.action = (Move::Action)action;
+  move.horizontal = horizontal != 0;
+  move.startrow = startrow;
+  move.startcol = startcol;
+  move.setTiles(tiles);
+  move.setPrettyTiles(prettyTiles);
+  move.score = score;
+  move.isBingo = isBingo != 0;
+  move.setScoreAddition(scoreAddition);
+  move.setIsChallengedPhoney(challengedPhoney != 0);
+  return true;
+}
+
+std::uint64_t Simulator::positionHash() const {
+  // FNV-1a over what the simulation doesn't randomize: the board,
+  // the scores and the rack to move
+  std::uint64_t hash = 14695981039346656037ull;
+  auto add = [&hash](std::uint64_t value) {
+    hash ^= value;
+    hash *= 1099511628211ull;
+  };
+
+  const GamePosition &position = m_originalGame.currentPosition();
+  const Board &board = position.board();
+  add(board.width());
+  add(board.height());
+  for (int row = 0; row < board.height(); ++row)
+    for (int col = 0; col < board.width(); ++col)
+      add(board.letter(row, col) | (board.isBlank(row, col) ? 0x100 : 0));
+
+  for (const auto &player : position.players()) {
+    add(player.id());
+    add(std::uint64_t(std::int64_t(player.score())));
+  }
+
+  add(position.currentPlayer().id());
+  for (const Letter letter : position.currentPlayer().rack().alphaTiles())
+    add(letter);
+
+  return hash;
+}
+
+bool Simulator::saveCheckpoint(const string &filename) const {
+  ofstream stream(filename.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!stream.is_open()) {
+    cerr << "Could not open " << filename << " to write simulation checkpoint"
+         << endl;
+    return false;
+  }
+
+  return saveCheckpoint(stream);
+}
+
+bool Simulator::saveCheckpoint(ostream &stream) const {
+  incorporateAccumulated();
+
+  stream.write(checkpointMagic, sizeof(checkpointMagic));
+  writeField(stream, checkpointVersion);
+  writeField(stream, positionHash());
+  writeField(stream, std::int32_t(m_iterations));
+  writeField(stream, m_scenarioSeed);
+
+  writeField(stream, std::uint32_t(m_simmedMoves.size()));
+  for (const auto &simmedMove : m_simmedMoves) {
+    writeMove(stream, simmedMove.move);
+    writeField(stream, std::uint8_t(simmedMove.includeInSimulation()));
+    writeField(stream, std::uint8_t(isConsideredMove(simmedMove.move)));
+    writeField(stream, std::int32_t(simmedMove.startedPlayaheads));
+    writeValue(stream, simmedMove.residual);
+    writeValue(stream, simmedMove.gameSpread);
+    writeValue(stream, simmedMove.wins);
+    writeValue(stream, simmedMove.playaheadEquity);
+
+    writeField(stream, std::uint32_t(simmedMove.levels.size()));
+    for (const auto &level : simmedMove.levels) {
+      writeField(stream, std::uint32_t(level.statistics.size()));
+      for (const auto &statistics : level.statistics) {
+        writeValue(stream, statistics.score);
+        writeValue(stream, statistics.bingos);
+      }
+    }
+
+    writeField(stream, std::uint32_t(simmedMove.playaheads.size()));
+    for (const auto &playahead : simmedMove.playaheads) {
+      writeField(stream, playahead.equity);
+      writeField(stream, playahead.wins);
+    }
+  }
+
+  return bool(stream);
+}
+
+bool Simulator::readCheckpoint(istream &stream, const string &filename,
+                               Checkpoint &checkpoint) const {
+  char magic[sizeof(checkpointMagic)];
+  std::uint32_t version;
+  std::uint64_t hash;
+  std::int32_t iterations;
+  std::uint32_t moveCount;
+  if (!stream.read(magic, sizeof(magic)) ||
+      memcmp(magic, checkpointMagic, sizeof(magic)) != 0 ||
+      !readField(stream, version) || version != checkpointVersion) {
+    cerr << filename << " is not a simulation checkpoint of version "
+         << checkpointVersion << endl;
+    return false;
+  }
+
+  if (!readField(stream, hash) || hash != positionHash()) {
+    cerr << filename << " is a checkpoint of another position" << endl;
+    return false;
+  }
+
+  bool ok = readField(stream, iterations) &&
+            readField(stream, checkpoint.scenarioSeed) &&
+            readField(stream, moveCount);
+  checkpoint.iterations = iterations;
+
+  for (std::uint32_t i = 0; ok && i < moveCount; ++i) {
+    Move move;
+    std::uint8_t included;
+    std::uint8_t considered;
+    std::int32_t startedPlayaheads;
+    ok = readMove(stream, move) && readField(stream, included) &&
+         readField(stream, considered) && readField(stream, startedPlayaheads);
+    if (!ok)
+      break;
+
+    checkpoint.simmedMoves.push_back(SimmedMove(move));
+    SimmedMove &simmedMove = checkpoint.simmedMoves.back();
+    simmedMove.setIncludeInSimulation(included != 0);
+    simmedMove.startedPlayaheads = startedPlayaheads;
+    if (considered)
+      checkpoint.consideredMoves.push_back(move);
+
+    std::uint32_t levelCount;
+    ok = readValue(stream, simmedMove.residual) &&
+         readValue(stream, simmedMove.gameSpread) &&
+         readValue(stream, simmedMove.wins) &&
+         readValue(stream, simmedMove.playaheadEquity) &&
+         readField(stream, levelCount);
+    simmedMove.levels.resize(ok ? levelCount : 0);
+    for (auto &level : simmedMove.levels) {
+      std::uint32_t statisticsCount;
+      ok = ok && readField(stream, statisticsCount);
+      level.statistics.resize(ok ? statisticsCount : 0);
+      for (auto &statistics : level.statistics)
+        ok = ok && readValue(stream, statistics.score) &&
+             readValue(stream, statistics.bingos);
+    }
+
+    std::uint32_t playaheadCount;
+    ok = ok && readField(stream, playaheadCount);
+    simmedMove.playaheads.resize(ok ? playaheadCount : 0);
+    for (auto &playahead : simmedMove.playaheads)
+      ok = ok && readField(stream, playahead.equity) &&
+           readField(stream, playahead.wins);
+  }
+
+  if (!ok)
+    cerr << filename << " is a truncated simulation checkpoint" << endl;
+  return ok;
+}
+
+SimmedMove &Simulator::simmedMoveToAddTo(const Move &move) {
+  for (auto &simmedMove : m_simmedMoves)
+    if (simmedMove.move == move)
+      return simmedMove;
+
+  m_simmedMoves.push_back(SimmedMove(move));
+  return m_simmedMoves.back();
+}
+
+// opens filename to read a checkpoint from, or complains
+static bool openCheckpoint(const string &filename, ifstream &stream) {
+  stream.open(filename.c_str(), ios::in | ios::binary);
+  if (!stream.is_open())
+    cerr << "Could not open " << filename << " to read simulation checkpoint"
+         << endl;
+  return stream.is_open();
+}
+
+bool Simulator::restoreCheckpoint(const string &filename) {
+  ifstream stream;
+  return openCheckpoint(filename, stream) &&
+         restoreCheckpoint(stream, filename);
+}
+
+bool Simulator::restoreCheckpoint(istream &stream, const string &name) {
+  Checkpoint checkpoint;
+  if (!readCheckpoint(stream, name, checkpoint))
+    return false;
+
+  resetNumbers();
+  for (auto &simmedMove : m_simmedMoves)
+    simmedMove.setIncludeInSimulation(false);
+
+  for (const auto &saved : checkpoint.simmedMoves) {
+    SimmedMove &simmedMove = simmedMoveToAddTo(saved.move);
+    simmedMove.levels = saved.levels;
+    simmedMove.residual = saved.residual;
+    simmedMove.gameSpread = saved.gameSpread;
+    simmedMove.wins = saved.wins;
+    simmedMove.playaheadEquity = saved.playaheadEquity;
+    simmedMove.playaheads = saved.playaheads;
+    simmedMove.startedPlayaheads = saved.startedPlayaheads;
+    simmedMove.setIncludeInSimulation(saved.includeInSimulation());
+  }
+
+  m_consideredMoves = checkpoint.consideredMoves;
+  m_iterations = checkpoint.iterations;
+  m_scenarioSeed = checkpoint.scenarioSeed;
+  return true;
+}
+
+bool Simulator::mergeCheckpoint(const string &filename) {
+  ifstream stream;
+  return openCheckpoint(filename, stream) &&
+         mergeCheckpoint(stream, filename);
+}
+
+bool Simulator::mergeCheckpoint(istream &stream, const string &name) {
+  Checkpoint checkpoint;
+  if (!readCheckpoint(stream, name, checkpoint))
+    return false;
+
+  incorporateAccumulated();
+
+  for (const auto &saved : checkpoint.simmedMoves) {
+    SimmedMove &simmedMove = simmedMoveToAddTo(saved.move);
+    simmedMove.levels.incorporateLevels(saved.levels);
+    simmedMove.residual.incorporateValues(saved.residual);
+    simmedMove.gameSpread.incorporateValues(saved.gameSpread);
+    simmedMove.wins.incorporateValues(saved.wins);
+    simmedMove.playaheadEquity.incorporateValues(saved.playaheadEquity);
+    simmedMove.playaheads.insert(simmedMove.playaheads.end(),
+                                 saved.playaheads.begin(),
+                                 saved.playaheads.end());
+    simmedMove.startedPlayaheads += saved.startedPlayaheads;
+  }
+
+  for (const auto &move : checkpoint.consideredMoves)
+    if (!isConsideredMove(move))
+      addConsideredMove(move);
+
+  m_iterations += checkpoint.iterations;
+  return true;
+}
+
 ////////////
 
 double AveragedValue::standardDeviation() const {
@@ -583,48 +1358,239 @@ void AveragedValue::clear() {
 
 ////////////
 
-void SimmedMoveMessageQueue::push(SimmedMoveMessage &msg) {
-  std::lock_guard<std::mutex> lk(m_queueMutex);
-  m_queue.push(std::move(msg));
-  m_condition.notify_one();
+SimmedMoveScheduler::~SimmedMoveScheduler() { setThreadCount(0); }
+
+void SimmedMoveScheduler::setThreadCount(size_t count) {
+  if (!m_threads.empty()) {
+    {
+      std::lock_guard<std::mutex> lk(m_mutex);
+      m_terminate = true;
+    }
+    m_workCondition.notify_all();
+    for (auto &t : m_threads)
+      t.join();
+    m_threads.clear();
+    m_terminate = false;
+  }
+
+  // there's always a deque for pushed tasks, even with no threads
+  while (m_deques.size() < std::max<size_t>(count, 1))
+    m_deques.emplace_back(new TaskDeque);
+  while (m_deques.size() > std::max<size_t>(count, 1)) {
+    // leftovers go to the first deque
+    for (const auto &task : m_deques.back()->tasks)
+      m_deques.front()->tasks.push_back(task);
+    m_deques.pop_back();
+  }
+
+  for (size_t worker = 0; worker < count; ++worker)
+    m_threads.emplace_back(&SimmedMoveScheduler::threadFunc, this, worker);
+}
+
+size_t SimmedMoveScheduler::threadCount() const { return m_threads.size(); }
+
+// whoever waits runs tasks as the worker after the last deque
+size_t SimmedMoveScheduler::workerCount() const { return m_deques.size() + 1; }
+
+void SimmedMoveScheduler::pushBatch(const vector<SimmedMoveTask> &tasks) {
+  if (tasks.empty())
+    return;
+
+  // counted first, so threads looking for work never see fewer tasks
+  // than there are in the deques
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_queued += tasks.size();
+  }
+
+  const size_t dequeCount = m_deques.size();
+  const size_t batchSize = (tasks.size() + dequeCount - 1) / dequeCount;
+  for (size_t i = 0, worker = 0; i < tasks.size(); i += batchSize, ++worker) {
+    TaskDeque &deque = *m_deques[worker];
+    std::lock_guard<std::mutex> lk(deque.mutex);
+    for (size_t j = i; j < tasks.size() && j < i + batchSize; ++j)
+      deque.tasks.push_back(tasks[j]);
+  }
+
+  m_workCondition.notify_all();
+}
+
+bool SimmedMoveScheduler::tryPop(size_t worker, SimmedMoveTask &task) {
+  if (m_queued == 0)
+    return false;
+
+  if (worker < m_deques.size()) {
+    TaskDeque &deque = *m_deques[worker];
+    std::lock_guard<std::mutex> lk(deque.mutex);
+    if (!deque.tasks.empty()) {
+      task = deque.tasks.front();
+      deque.tasks.pop_front();
+      --m_queued;
+      return true;
+    }
+  }
+
+  for (size_t i = 1; i <= m_deques.size(); ++i) {
+    TaskDeque &deque = *m_deques[(worker + i) % m_deques.size()];
+    std::lock_guard<std::mutex> lk(deque.mutex);
+    if (!deque.tasks.empty()) {
+      task = deque.tasks.back();
+      deque.tasks.pop_back();
+      --m_queued;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void SimmedMoveScheduler::run(const SimmedMoveTask &task, size_t worker) {
+  Simulator::simulateOnePosition(*task.message, *task.constants, worker);
+  if (task.accumulator)
+    task.accumulator->incorporate(worker, task.candidate, *task.message);
+
+  if (--*task.remaining == 0) {
+    // taking the lock means a waiter is either still to check
+    // remaining or already waiting to be woken
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_doneCondition.notify_all();
+  }
+}
+
+void SimmedMoveScheduler::threadFunc(size_t worker) {
+  SimmedMoveTask task;
+  while (true) {
+    if (tryPop(worker, task)) {
+      run(task, worker);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lk(m_mutex);
+    m_workCondition.wait(lk, [this] { return m_terminate || m_queued > 0; });
+    if (m_terminate)
+      break;
+  }
 }
 
-std::pair<SimmedMoveMessage, bool> SimmedMoveMessageQueue::pop_or_terminate() {
-  std::unique_lock<std::mutex> lk(m_queueMutex);
-  while (m_queue.empty() && !m_terminateAll &&
-         m_terminateOne != std::this_thread::get_id())
-    m_condition.wait(lk);
-  std::pair<SimmedMoveMessage, bool> result;
-  result.second =
-      m_terminateAll || m_terminateOne == std::this_thread::get_id();
-  if (result.second)
-    m_terminateOne = std::thread::id();
-  else {
-    result.first = std::move(m_queue.front());
-    m_queue.pop();
+void SimmedMoveScheduler::waitFor(const std::atomic<int> &remaining) {
+  SimmedMoveTask task;
+  while (remaining > 0) {
+    if (tryPop(m_deques.size(), task)) {
+      run(task, m_deques.size());
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lk(m_mutex);
+    m_doneCondition.wait(lk, [&remaining] { return remaining == 0; });
   }
-  return result;
 }
 
-SimmedMoveMessage SimmedMoveMessageQueue::pop() {
-  std::unique_lock<std::mutex> lk(m_queueMutex);
-  while (m_queue.empty())
-    m_condition.wait(lk);
-  SimmedMoveMessage result = std::move(m_queue.front());
-  m_queue.pop();
-  return result;
+////////////
+
+void SimmedMoveAccumulator::reset(size_t threads, size_t candidates,
+                                  int levels, int players) {
+  m_candidates = candidates;
+  m_levels = levels;
+  m_players = players;
+
+  m_threads.clear();
+  for (size_t i = 0; i < threads; ++i) {
+    m_threads.emplace_back(new ThreadSums);
+    m_threads.back()->values.resize(candidates * blockSize());
+    m_threads.back()->numberScores.resize(candidates * levels);
+  }
 }
 
-void SimmedMoveMessageQueue::send_terminate_all() {
-  std::lock_guard<std::mutex> lk(m_queueMutex);
-  m_terminateAll = true;
-  m_condition.notify_all();
+bool SimmedMoveAccumulator::fits(size_t threads, size_t candidates,
+                                 int levels, int players) const {
+  return m_threads.size() >= threads && m_candidates >= candidates &&
+         m_levels == levels && m_players == players;
 }
 
-void SimmedMoveMessageQueue::send_terminate_one(const std::thread::id &id) {
-  std::lock_guard<std::mutex> lk(m_queueMutex);
-  m_terminateOne = id;
-  m_condition.notify_all();
+void SimmedMoveAccumulator::incorporate(size_t thread, size_t candidate,
+                                        const SimmedMoveMessage &message) {
+  ThreadSums &sums = *m_threads[thread];
+  AveragedValue *block = &sums.values[candidate * blockSize()];
+  int *numberScores = &sums.numberScores[candidate * m_levels];
+
+  block[Residual].incorporateValue(message.residual);
+  block[GameSpread].incorporateValue(message.gameSpread);
+  block[Wins].incorporateValue(message.wins);
+  block[Equity].incorporateValue(message.equity);
+
+  const int levels = std::min(m_levels, int(message.levels.size()));
+  for (int level = 0; level < levels; ++level) {
+    const PositionStatisticsList &statistics = message.levels[level].statistics;
+    const int players = std::min(m_players, int(statistics.size()));
+    numberScores[level] = std::max(numberScores[level], players);
+
+    AveragedValue *values = block + LevelValues + 2 * level * m_players;
+    for (int player = 0; player < players; ++player) {
+      values[2 * player].incorporateValues(statistics[player].score);
+      values[2 * player + 1].incorporateValues(statistics[player].bingos);
+    }
+  }
+
+  if (m_recordPlayaheads)
+    sums.playaheads.push_back(
+        {candidate, message.scenario, message.equity, message.wins});
+  ++sums.incorporated;
+}
+
+void SimmedMoveAccumulator::incorporateInto(SimmedMoveList &moves) {
+  for (auto &thread : m_threads) {
+    ThreadSums &sums = *thread;
+    if (sums.incorporated == 0)
+      continue;
+
+    const size_t candidates = std::min(m_candidates, moves.size());
+    for (size_t candidate = 0; candidate < candidates; ++candidate) {
+      AveragedValue *block = &sums.values[candidate * blockSize()];
+      if (!block[Wins].hasValues())
+        continue;
+
+      SimmedMove &move = moves[candidate];
+      move.residual.incorporateValues(block[Residual]);
+      move.gameSpread.incorporateValues(block[GameSpread]);
+      move.wins.incorporateValues(block[Wins]);
+      move.playaheadEquity.incorporateValues(block[Equity]);
+      block[Residual].clear();
+      block[GameSpread].clear();
+      block[Wins].clear();
+      block[Equity].clear();
+
+      move.levels.setNumberLevels(m_levels);
+      int *numberScores = &sums.numberScores[candidate * m_levels];
+      for (int level = 0; level < m_levels; ++level) {
+        if (numberScores[level] == 0)
+          continue;
+
+        Level &into = move.levels[level];
+        into.setNumberScores(numberScores[level]);
+        AveragedValue *values = block + LevelValues + 2 * level * m_players;
+        for (int player = 0; player < numberScores[level]; ++player) {
+          into.statistics[player].score.incorporateValues(values[2 * player]);
+          into.statistics[player].bingos.incorporateValues(
+              values[2 * player + 1]);
+          values[2 * player].clear();
+          values[2 * player + 1].clear();
+        }
+        numberScores[level] = 0;
+      }
+    }
+
+    for (const auto &playahead : sums.playaheads) {
+      if (playahead.candidate >= moves.size())
+        continue;
+      vector<SimmedMove::Playahead> &into =
+          moves[playahead.candidate].playaheads;
+      if (into.size() <= size_t(playahead.scenario))
+        into.resize(playahead.scenario + 1);
+      into[playahead.scenario] = {playahead.equity, playahead.wins};
+    }
+    sums.playaheads.clear();
+    sums.incorporated = 0;
+  }
 }
 
 ////////////
@@ -661,13 +1627,50 @@ void LevelList::setNumberLevels(unsigned int number) {
     push_back(Level());
 }
 
-void SimmedMove::clear() { levels.clear(); }
+void LevelList::incorporateLevels(const LevelList &other) {
+  setNumberLevels(other.size());
+  for (size_t i = 0; i < other.size(); ++i)
+    (*this)[i].incorporateLevel(other[i]);
+}
+
+void SimmedMove::clear() {
+  levels.clear();
+  residual.clear();
+  gameSpread.clear();
+  wins.clear();
+  playaheadEquity.clear();
+  playaheads.clear();
+  startedPlayaheads = 0;
+}
+
+AveragedValue SimmedMove::playaheadValues(bool byWin) const {
+  return byWin ? wins : playaheadEquity;
+}
+
+AveragedValue SimmedMove::pairedDifference(const SimmedMove &other,
+                                           bool byWin) const {
+  AveragedValue ret;
+  const size_t count = std::min(playaheads.size(), other.playaheads.size());
+  for (size_t i = 0; i < count; ++i) {
+    const Playahead &ours = playaheads[i];
+    const Playahead &theirs = other.playaheads[i];
+    ret.incorporateValue(byWin ? ours.wins - theirs.wins
+                               : ours.equity - theirs.equity);
+  }
+  return ret;
+}
 
 PositionStatistics SimmedMove::getPositionStatistics(int level,
                                                      int playerIndex) const {
   return levels[level].statistics[playerIndex];
 }
 
+void PositionStatistics::incorporateStatistics(
+    const PositionStatistics &other) {
+  score.incorporateValues(other.score);
+  bingos.incorporateValues(other.bingos);
+}
+
 AveragedValue PositionStatistics::getStatistic(StatisticType type) const {
   switch (type) {
   case StatisticScore:
@@ -686,6 +1689,12 @@ void Level::setNumberScores(unsigned int number) {
     statistics.push_back(PositionStatistics());
 }
 
+void Level::incorporateLevel(const Level &other) {
+  setNumberScores(other.statistics.size());
+  for (size_t i = 0; i < other.statistics.size(); ++i)
+    statistics[i].incorporateStatistics(other.statistics[i]);
+}
+
 //////////
 
 UVOStream &operator<<(UVOStream &o, const Quackle::AveragedValue &value) {
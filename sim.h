@@ -21,14 +21,18 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <memory>
 #include <mutex>
-#include <queue>
-#include <sstream>
 #include <thread>
 #include <vector>
 
 #include "alphabetparameters.h"
 #include "game.h"
+#include "rollout.h"
+#include "simtrace.h"
 
 using std::vector;
 
@@ -41,8 +45,17 @@ struct AveragedValue {
   AveragedValue()
       : m_valueSum(0), m_squaredValueSum(0), m_incorporatedValues(0) {}
 
+  // a value with the sums of another, as saved in a checkpoint
+  AveragedValue(long double valueSum, long double squaredValueSum,
+                long int incorporatedValues)
+      : m_valueSum(valueSum), m_squaredValueSum(squaredValueSum),
+        m_incorporatedValues(incorporatedValues) {}
+
   void incorporateValue(double newValue);
 
+  // add in all the values other has incorporated
+  void incorporateValues(const AveragedValue &other);
+
   // zero everything
   void clear();
 
@@ -73,6 +86,12 @@ inline void AveragedValue::incorporateValue(double newValue) {
   ++m_incorporatedValues;
 }
 
+inline void AveragedValue::incorporateValues(const AveragedValue &other) {
+  m_valueSum += other.m_valueSum;
+  m_squaredValueSum += other.m_squaredValueSum;
+  m_incorporatedValues += other.m_incorporatedValues;
+}
+
 inline long double AveragedValue::valueSum() const { return m_valueSum; }
 
 inline long double AveragedValue::squaredValueSum() const {
@@ -95,6 +114,8 @@ struct PositionStatistics {
   enum StatisticType { StatisticScore, StatisticBingos };
   AveragedValue getStatistic(StatisticType type) const;
 
+  void incorporateStatistics(const PositionStatistics &other);
+
   AveragedValue score;
   AveragedValue bingos;
 };
@@ -105,6 +126,9 @@ struct Level {
   // expand the scores list to be at least number long
   void setNumberScores(unsigned int number);
 
+  // expand the scores list to cover other's and add in its statistics
+  void incorporateLevel(const Level &other);
+
   PositionStatisticsList statistics;
 };
 
@@ -112,11 +136,15 @@ class LevelList : public vector<Level> {
 public:
   // expand the levels list to be at least number long
   void setNumberLevels(unsigned int number);
+
+  // expand the levels list to cover other's and add in its statistics
+  void incorporateLevels(const LevelList &other);
 };
 
 struct SimmedMove {
   SimmedMove(const Move &_move)
-      : move(_move), m_id(++objectIdCounter), m_includeInSimulation(true) {}
+      : move(_move), startedPlayaheads(0), m_id(++objectIdCounter),
+        m_includeInSimulation(true) {}
 
   // + our scores - their scores + residual, except if we have no levels,
   // in which case returns move.equity
@@ -126,9 +154,19 @@ struct SimmedMove {
   // in which case returns move.win
   double calculateWinPercentage() const;
 
-  // clear all level values
+  // clear all level values, other statistics and playaheads
   void clear();
 
+  // the differences between our playaheads and other's, paired up
+  // by the order they were started in; with common random numbers,
+  // each pair was played out from the same tiles. Only playaheads run
+  // with common random numbers are kept to pair up.
+  AveragedValue pairedDifference(const SimmedMove &other,
+                                 bool byWin = false) const;
+
+  // the playahead values behind calculateEquity(), or wins if byWin
+  AveragedValue playaheadValues(bool byWin = false) const;
+
   bool includeInSimulation() const;
   void setIncludeInSimulation(bool includeInSimulation);
 
@@ -139,6 +177,19 @@ struct SimmedMove {
   AveragedValue residual;
   AveragedValue gameSpread;
   AveragedValue wins;
+  // what each playahead added to calculateEquity()
+  AveragedValue playaheadEquity;
+
+  // what each playahead added to calculateEquity() and wins, by
+  // scenario, for pairing up; kept only with common random numbers
+  struct Playahead {
+    double equity;
+    double wins;
+  };
+  vector<Playahead> playaheads;
+
+  // including those not incorporated yet
+  int startedPlayaheads;
 
   PositionStatistics getPositionStatistics(int level, int playerIndex) const;
 
@@ -159,57 +210,169 @@ inline void SimmedMove::setIncludeInSimulation(bool includeInSimulation) {
 
 typedef vector<SimmedMove> SimmedMoveList;
 
+// The playahead of one candidate in one iteration. levels start out
+// empty and get just this playahead's statistics.
 class SimmedMoveMessage {
 public:
   long id;
   Move move;
   LevelList levels;
-  vector<double> score;
-  vector<double> bingos;
   double residual;
   double gameSpread;
   double wins;
 
+  // our scores less theirs plus residual
+  double equity;
+
+  // which of its candidate's playaheads this is
+  int scenario;
+
   bool bogowin;
-  std::ostringstream logStream;
-  UVString xmlIndent;
+
+  // where the playahead's trace records go: its iteration, its order
+  // in the trace and its place in the iteration
+  int iteration;
+  int traceOrder;
+  int index;
+};
+
+// Running sums of finished playaheads, kept per thread so that threads
+// don't contend for them, and folded into the SimmedMoves when they're
+// next read. Each thread's sums are cache-line aligned and flat: a
+// block per candidate of residual, game spread and wins, then score
+// and bingos for each player at each level.
+class SimmedMoveAccumulator {
+public:
+  // Lay out zeroed sums for threads threads, of candidates
+  // candidates with levels levels of players players. Any sums
+  // already accumulated are lost.
+  void reset(size_t threads, size_t candidates, int levels, int players);
+  bool fits(size_t threads, size_t candidates, int levels,
+            int players) const;
+
+  // whether to keep each playahead's values as well as their sums,
+  // for SimmedMove::playaheads
+  void setRecordPlayaheads(bool record);
+
+  // add in a playahead of candidate thread has finished; only
+  // thread may call this, and only it touches its sums meanwhile
+  void incorporate(size_t thread, size_t candidate,
+                   const SimmedMoveMessage &message);
+
+  // Add all the sums into moves, indexed by candidate, and zero
+  // them. Must not run while any thread is incorporating.
+  void incorporateInto(SimmedMoveList &moves);
+
+private:
+  struct Playahead {
+    size_t candidate;
+    int scenario;
+    double equity;
+    double wins;
+  };
+
+  struct alignas(64) ThreadSums {
+    vector<AveragedValue> values;
+    // how many players' scores each level of each candidate has
+    vector<int> numberScores;
+    vector<Playahead> playaheads;
+    // how many playaheads have been added in since the last fold
+    size_t incorporated = 0;
+  };
+
+  enum { Residual, GameSpread, Wins, Equity, LevelValues };
+
+  size_t blockSize() const;
+
+  vector<std::unique_ptr<ThreadSums>> m_threads;
+  size_t m_candidates = 0;
+  int m_levels = 0;
+  int m_players = 0;
+  bool m_recordPlayaheads = false;
 };
 
+inline void SimmedMoveAccumulator::setRecordPlayaheads(bool record) {
+  m_recordPlayaheads = record;
+}
+
+inline size_t SimmedMoveAccumulator::blockSize() const {
+  return LevelValues + 2 * m_levels * m_players;
+}
+
+// what every playahead of one iteration starts from
 class SimmedMoveConstants {
 public:
-  Game game;
+  RolloutPosition start;
   int startPlayerId;
   int playerCount;
   int decimalTurns;
   int levelCount;
   bool ignoreOppos;
-  bool isLogging;
+  // null unless logging
+  SimTraceWriter *trace;
+};
+
+// One playahead to run. remaining counts down the playaheads of its
+// iteration still to finish.
+struct SimmedMoveTask {
+  SimmedMoveMessage *message;
+  const SimmedMoveConstants *constants;
+  std::atomic<int> *remaining;
+  // where to add the finished playahead, as candidate
+  SimmedMoveAccumulator *accumulator;
+  size_t candidate;
 };
 
-class SimmedMoveMessageQueue {
+// Hands playaheads to the simulation threads. Each thread has its own
+// deque of tasks, taken in order from the front; a thread with none
+// left steals from the back of another's. Batches of tasks are shared
+// out among the deques as they're pushed.
+class SimmedMoveScheduler {
 public:
-  SimmedMoveMessageQueue() = default;
-  SimmedMoveMessageQueue(SimmedMoveMessageQueue &) = delete;
-  SimmedMoveMessageQueue(SimmedMoveMessageQueue &&) = delete;
-
-  void push(SimmedMoveMessage &msg);
-  SimmedMoveMessage pop();
-  std::pair<SimmedMoveMessage, bool> pop_or_terminate();
-  void send_terminate_all();
-  void send_terminate_one(const std::thread::id &id);
-
-  const SimmedMoveConstants &constants() { return m_constants; };
-  void setConstants(const SimmedMoveConstants &constants) {
-    m_constants = constants;
-  };
+  SimmedMoveScheduler() = default;
+  SimmedMoveScheduler(SimmedMoveScheduler &) = delete;
+  SimmedMoveScheduler(SimmedMoveScheduler &&) = delete;
+  ~SimmedMoveScheduler();
+
+  // Start count threads, after stopping any running now; with none,
+  // tasks are only run by whoever waits on them.
+  void setThreadCount(size_t count);
+  size_t threadCount() const;
+
+  // How many threads may run tasks, including whoever waits; tasks
+  // are run by worker numbers below this.
+  size_t workerCount() const;
+
+  // give each thread a run of consecutive tasks
+  void pushBatch(const vector<SimmedMoveTask> &tasks);
+
+  // run tasks, stealing them from the threads if need be, until
+  // remaining reaches zero
+  void waitFor(const std::atomic<int> &remaining);
 
 private:
-  SimmedMoveConstants m_constants;
-  std::queue<SimmedMoveMessage> m_queue;
-  std::condition_variable m_condition;
-  std::mutex m_queueMutex;
-  bool m_terminateAll = false;
-  std::thread::id m_terminateOne;
+  struct alignas(64) TaskDeque {
+    std::mutex mutex;
+    std::deque<SimmedMoveTask> tasks;
+  };
+
+  void threadFunc(size_t worker);
+
+  // take a task from worker's deque, or from the back of another;
+  // worker may be past the end to only steal
+  bool tryPop(size_t worker, SimmedMoveTask &task);
+
+  void run(const SimmedMoveTask &task, size_t worker);
+
+  vector<std::unique_ptr<TaskDeque>> m_deques;
+  vector<std::thread> m_threads;
+
+  // guards the waiting below
+  std::mutex m_mutex;
+  std::condition_variable m_workCondition;
+  std::condition_variable m_doneCondition;
+  std::atomic<size_t> m_queued{0};
+  bool m_terminate = false;
 };
 
 class Simulator {
@@ -235,18 +398,17 @@ public:
   // If logfile is the same logfile as currently set, nothing
   // happens. If it is different, old logfile is closed if it
   // was open. If append is false, this destroys file contents
-  // already in logfile.
+  // already in logfile; if it is true and logfile holds anything but
+  // traces, nothing is logged. The log is a binary trace of every ply;
+  // convertSimTraceToXml turns it into the XML log.
   void setLogfile(const string &logfile, bool append = true);
   string logfile() const;
 
-  // Will honor dispatch->shouldAbort() but won't signal
-  // any doneness for now.
+  // Will honor dispatch->shouldAbort(). Only race() signals
+  // doneness, as the fraction of its budget spent.
   void setDispatch(ComputerDispatch *dispatch);
   ComputerDispatch *dispatch() const;
 
-  // append message to logfile if one is open
-  void logMessage(const UVString &message);
-
   bool isLogging() const;
   void closeLogfile();
 
@@ -268,15 +430,30 @@ public:
 
   // include only currently included moves that are within
   // equityThreshold points below the best play and cap at
-  // maxNumberOfMoves
+  // maxNumberOfMoves; with common random numbers, how far below
+  // is the paired difference
   void pruneTo(double equityThreshold, int maxNumberOfMoves);
 
+  // Stop including moves that are clearly worse than the best by
+  // win or equity: the top of their 95% confidence interval is below
+  // the bottom of the best's or, with common random numbers, their
+  // paired difference from the best is below zero with 95%
+  // confidence. Considered moves are never dropped.
+  void pruneClearlyWorse(bool byWin = false);
+
+  // If on, the nth playahead of every candidate starts from the same
+  // randomly chosen oppo racks and bag, and draws the same tiles
+  // from it, so differences between candidates aren't swamped by the
+  // luck of the draw. The tiles are chosen afresh on setPosition.
+  void setCommonRandomNumbers(bool common);
+  bool commonRandomNumbers() const;
+
   // if ignore is true, oppos will always pass in simulation
   void setIgnoreOppos(bool ignore);
   bool ignoreOppos() const;
 
-  static void simThreadFunc(SimmedMoveMessageQueue &incoming,
-                            SimmedMoveMessageQueue &outgoing);
+  // Number of threads running playaheads. The candidates of several
+  // iterations are in flight at once, spread across the threads.
   void setThreadCount(size_t count);
 
   // set values for all levels of all moves to zero
@@ -291,13 +468,42 @@ public:
 
   // simulate one iteration
   void simulate(int plies);
+
+  // Race the included moves: simulate them in batches of iterations,
+  // pruning the clearly worse ones after each, until only one is left,
+  // maxIterations have been run or maxSeconds (if positive) have
+  // passed. Returns how many iterations were run.
+  int race(int plies, int maxIterations, int maxSeconds,
+           bool byWin = false);
+
+  // Run iterations iterations split among shards worker processes,
+  // each seeded from its own stream, and merge what they send back
+  // over a local socket into our numbers. Each process runs as many
+  // threads as we do and none logs. Iterations a process fails to
+  // return are run here instead; on an abort the processes are killed
+  // and their iterations dropped. Where processes can't be forked, all
+  // of it is run here.
+  //
+  // The processes are forked without exec. Our own threads and the
+  // trace writer's are stopped while forking, but any other threads
+  // of the program, such as a GUI's, must not be holding locks the
+  // shards need, so call this only where no other threads run.
+  void simulateSharded(int plies, int iterations, int shards);
+
+  // play out message's candidate from constants; worker is the
+  // trace buffer to write to
   static void simulateOnePosition(SimmedMoveMessage &message,
-                                  const SimmedMoveConstants &constants);
+                                  const SimmedMoveConstants &constants,
+                                  size_t worker);
 
   // Incorporate the results of a single simulation into the
   // cumulative results
   void incorporateMessage(const SimmedMoveMessage &message);
 
+  // Fold the sums the threads have accumulated into the simmed
+  // moves; done by everything reading them.
+  void incorporateAccumulated() const;
+
   // Set oppo's rack to some partially-known tiles.
   // Set this to an empty rack if no tiles are known, so
   // that all tiles are chosen randomly each iteration.
@@ -329,25 +535,109 @@ public:
 
   const SimmedMove &simmedMoveForMove(const Move &move) const;
 
+  // move's paired difference from the best included move
+  AveragedValue pairedDifference(const Move &move, bool byWin = false) const;
+
   int numLevels() const;
   int numPlayersAtLevel(int levelIndex) const;
 
+  // Save the numbers of every simmed move, the iteration count and the
+  // common random number seed to filename, so the simulation can be
+  // carried on later or elsewhere. Returns false if it can't be
+  // written.
+  bool saveCheckpoint(const string &filename) const;
+  bool saveCheckpoint(std::ostream &stream) const;
+
+  // Replace the numbers, included and considered moves and seed with
+  // those saved in filename. Under common random numbers the
+  // simulation then carries on as the saved one would have; otherwise
+  // its playaheads come from the DataManager's random numbers, which
+  // aren't saved, so it carries on with other ones. Call setPosition
+  // first: returns false, changing nothing, if the checkpoint is of
+  // another position.
+  bool restoreCheckpoint(const string &filename);
+  // name is what to call stream in complaints
+  bool restoreCheckpoint(std::istream &stream, const string &name);
+
+  // Add the numbers saved in filename, from a simulation of the current
+  // position run elsewhere, to ours, so iterations can be shared out
+  // among processes or machines. Moves we don't have are added, and
+  // playaheads appended. Returns false, changing nothing, if the
+  // checkpoint is of another position.
+  bool mergeCheckpoint(const string &filename);
+  bool mergeCheckpoint(std::istream &stream, const string &name);
+
 protected:
+  // an iteration's position and the playaheads of its candidates
+  struct SimmedIteration {
+    int index;
+    int traceOrder;
+    // one per scenario its candidates start from
+    std::deque<SimmedMoveConstants> constants;
+    vector<SimmedMoveMessage> messages;
+    std::atomic<int> remaining;
+  };
+
+  // randomize the position for a new iteration and queue its
+  // playaheads
+  std::unique_ptr<SimmedIteration> startIteration(int plies);
+
+  // wait for an iteration's playaheads and incorporate them
+  void finishIteration(SimmedIteration &iteration);
+
+  // set up the oppo racks and bag of playahead number scenario
+  // of each candidate under common random numbers
+  void setUpScenario(int scenario, RolloutPosition &start) const;
+
+  // set the accumulator up for playaheads of plies, keeping what
+  // it has so far
+  void prepareAccumulator(int plies);
+
+  struct Checkpoint {
+    int iterations;
+    std::uint64_t scenarioSeed;
+    SimmedMoveList simmedMoves;
+    MoveList consideredMoves;
+  };
+
+  // read stream, checking it is of the current position; filename is
+  // what to call it in complaints
+  bool readCheckpoint(std::istream &stream, const string &filename,
+                      Checkpoint &checkpoint) const;
+
+  // in a forked process, run iterations of shard with a simulator of
+  // our own of threads threads seeded from seed, and send its
+  // checkpoint down socket
+  bool runShard(int socket, const std::vector<unsigned> &seed, int plies,
+                int iterations, size_t threads) const;
+
+  // the simmed move for move, added if we don't have one
+  SimmedMove &simmedMoveToAddTo(const Move &move);
+
+  // identifies the current position in a checkpoint
+  std::uint64_t positionHash() const;
+
   void writeLogHeader();
   void writeLogFooter();
 
-  UVOFStream m_logfileStream;
+  // the trace buffer of whoever runs the simulation
+  size_t traceWorker() const;
+
+  SimTraceWriter m_trace;
   string m_logfile;
-  bool m_logfileIsOpen;
   bool m_hasHeader;
-  UVString m_xmlIndent;
+  // iterations started since the logfile was opened
+  int m_traceOrder;
 
   Rack m_partialOppoRack;
 
   Game m_originalGame;
   ComputerDispatch *m_dispatch;
 
-  SimmedMoveList m_simmedMoves;
+  // the playaheads the threads have finished are only folded into
+  // these when they're read
+  mutable SimmedMoveList m_simmedMoves;
+  mutable SimmedMoveAccumulator m_accumulator;
 
   // moves that are immune from pruning
   MoveList m_consideredMoves;
@@ -355,10 +645,10 @@ protected:
   int m_iterations;
   bool m_ignoreOppos;
 
-  // Pair of thread and bool requesting to terminate
-  std::vector<std::thread> m_threadPool;
-  SimmedMoveMessageQueue m_sendQueue;
-  SimmedMoveMessageQueue m_receiveQueue;
+  bool m_commonRandomNumbers;
+  std::uint64_t m_scenarioSeed;
+
+  SimmedMoveScheduler m_scheduler;
 };
 
 inline GamePosition &Simulator::currentPosition() {
@@ -377,7 +667,7 @@ inline ComputerDispatch *Simulator::dispatch() const { return m_dispatch; }
 
 inline string Simulator::logfile() const { return m_logfile; }
 
-inline bool Simulator::isLogging() const { return m_logfileIsOpen; }
+inline bool Simulator::isLogging() const { return m_trace.isOpen(); }
 
 inline const Rack &Simulator::partialOppoRack() const {
   return m_partialOppoRack;
@@ -395,11 +685,20 @@ inline void Simulator::setIgnoreOppos(bool ignore) { m_ignoreOppos = ignore; }
 
 inline bool Simulator::ignoreOppos() const { return m_ignoreOppos; }
 
+inline void Simulator::setCommonRandomNumbers(bool common) {
+  m_commonRandomNumbers = common;
+}
+
+inline bool Simulator::commonRandomNumbers() const {
+  return m_commonRandomNumbers;
+}
+
 inline int Simulator::iterations() const { return m_iterations; }
 
 inline bool Simulator::hasSimulationResults() const { return m_iterations > 0; }
 
 inline const SimmedMoveList &Simulator::simmedMoves() const {
+  incorporateAccumulated();
   return m_simmedMoves;
 }
 
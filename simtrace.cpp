@@ -0,0 +1,332 @@
+/*
+ *  Quackle -- Crossword game artificial intelligence and analysis tool
+ *  Copyright (C) 2005-2019 Jason Katz-Brown, John O'Laughlin, and John Fultz.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <tuple>
+
+#include "rack.h"
+#include "simtrace.h"
+
+using namespace Quackle;
+using namespace std;
+
+static_assert(sizeof(SimTraceRecord) == 128,
+              "trace records are read back at the size they were written");
+
+static const char traceMagic[SimTraceRecord::MaximumRackLength] =
+    "quacklesimtrace";
+
+SimTraceRecord::SimTraceRecord()
+    : type(FileHeader), flags(0), rackLength(0), order(0), iteration(0),
+      candidate(0), ply(0), candidateId(0), value(0), sharedConsideration(0),
+      move(), rack() {}
+
+SimTraceRecord SimTraceRecord::fileHeader() {
+  SimTraceRecord record;
+  record.type = FileHeader;
+  record.iteration = Version;
+  record.ply = sizeof(SimTraceRecord);
+  memcpy(record.rack, traceMagic, sizeof(record.rack));
+  return record;
+}
+
+bool SimTraceRecord::isValidFileHeader() const {
+  return type == FileHeader && iteration == Version &&
+         ply == sizeof(SimTraceRecord) &&
+         memcmp(rack, traceMagic, sizeof(rack)) == 0;
+}
+
+SimTraceWriter::~SimTraceWriter() { close(); }
+
+bool SimTraceWriter::open(const string &filename, bool append,
+                          size_t workers) {
+  close();
+
+  // Records appended to anything but a trace of this version would
+  // make the whole file unreadable, so leave such a file alone.
+  if (append) {
+    ifstream existing(filename.c_str(), ios::in | ios::binary);
+    SimTraceRecord header;
+    existing.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (existing.gcount() > 0 &&
+        (existing.gcount() != sizeof(header) || !header.isValidFileHeader())) {
+      cerr << filename << " is not a simulation trace; not appending to it"
+           << endl;
+      return false;
+    }
+  }
+
+  const ios::openmode flags =
+      ios::out | ios::binary | (append ? ios::app : ios::trunc);
+  m_stream.open(filename.c_str(), flags);
+  if (!m_stream.is_open())
+    return false;
+
+  const SimTraceRecord header = SimTraceRecord::fileHeader();
+  m_stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  startThread(workers);
+  return true;
+}
+
+void SimTraceWriter::close() {
+  if (!isOpen())
+    return;
+
+  stopThread();
+  m_rings.clear();
+  m_stream.close();
+}
+
+void SimTraceWriter::setWorkerCount(size_t workers) {
+  if (!isOpen() || workers == m_rings.size())
+    return;
+
+  stopThread();
+  startThread(workers);
+}
+
+void SimTraceWriter::startThread(size_t workers) {
+  m_rings.clear();
+  for (size_t i = 0; i < workers; ++i)
+    m_rings.emplace_back(new Ring);
+
+  m_stop = false;
+  m_thread = std::thread(&SimTraceWriter::threadFunc, this);
+}
+
+void SimTraceWriter::stopThread() {
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_stop = true;
+  }
+  m_condition.notify_one();
+  m_thread.join();
+
+  // whatever was queued after the thread last looked
+  drain();
+  m_stream.flush();
+}
+
+void SimTraceWriter::write(size_t worker, const SimTraceRecord &record) {
+  Ring &ring = *m_rings[worker];
+  const size_t head = ring.head.load(std::memory_order_relaxed);
+
+  while (head - ring.tail.load(std::memory_order_acquire) >= RingSize) {
+    m_condition.notify_one();
+    std::this_thread::yield();
+  }
+
+  ring.records[head % RingSize] = record;
+  ring.head.store(head + 1, std::memory_order_release);
+
+  // don't leave the thread dozing with a buffer half full
+  if (head % (RingSize / 2) == 0)
+    m_condition.notify_one();
+}
+
+void SimTraceWriter::threadFunc() {
+  std::unique_lock<std::mutex> lk(m_mutex);
+  while (!m_stop) {
+    lk.unlock();
+    const bool wrote = drain();
+    lk.lock();
+
+    if (!wrote && !m_stop)
+      m_condition.wait_for(lk, std::chrono::milliseconds(10));
+  }
+}
+
+bool SimTraceWriter::drain() {
+  // Take every head before writing any ring, the last ring's first.
+  // The simulator queues IterationEnd on the last ring once the other
+  // workers have queued their records of the iteration, so those are
+  // all taken along with it, and written before it.
+  vector<size_t> heads(m_rings.size());
+  for (size_t i = m_rings.size(); i-- > 0;)
+    heads[i] = m_rings[i]->head.load(std::memory_order_acquire);
+
+  bool wrote = false;
+  for (size_t i = 0; i < m_rings.size(); ++i) {
+    Ring *ring = m_rings[i].get();
+    const size_t head = heads[i];
+    size_t tail = ring->tail.load(std::memory_order_relaxed);
+
+    while (tail != head) {
+      // as far as the end of the ring in one go
+      const size_t start = tail % RingSize;
+      const size_t count = std::min(head - tail, RingSize - start);
+      m_stream.write(reinterpret_cast<const char *>(&ring->records[start]),
+                     count * sizeof(SimTraceRecord));
+      tail += count;
+      wrote = true;
+    }
+
+    ring->tail.store(tail, std::memory_order_release);
+  }
+  return wrote;
+}
+
+// where a record goes among those of its trace
+static std::tuple<int, int, int, bool, int>
+xmlOrder(const SimTraceRecord &record) {
+  const int phase = record.type == SimTraceRecord::SimulationStart ? 0
+                    : record.type == SimTraceRecord::SimulationEnd ? 2
+                                                                   : 1;
+  return std::make_tuple(record.order, phase, record.candidate,
+                         record.type == SimTraceRecord::Playahead,
+                         record.ply);
+}
+
+static void writeXml(vector<SimTraceRecord> &records, UVOFStream &xml) {
+  std::stable_sort(records.begin(), records.end(),
+                   [](const SimTraceRecord &a, const SimTraceRecord &b) {
+                     return xmlOrder(a) < xmlOrder(b);
+                   });
+
+  bool inIteration = false;
+  int order = 0;
+
+  for (const auto &record : records) {
+    const bool playahead = record.type == SimTraceRecord::Ply ||
+                           record.type == SimTraceRecord::Playahead;
+
+    if (inIteration && (!playahead || record.order != order)) {
+      xml << "\t</iteration>" << endl;
+      inIteration = false;
+    }
+
+    if (playahead && !inIteration) {
+      xml << "\t<iteration index=\"" << record.iteration << "\">" << endl;
+      inIteration = true;
+      order = record.order;
+    }
+
+    switch (record.type) {
+    case SimTraceRecord::FileHeader:
+      break;
+
+    case SimTraceRecord::SimulationStart:
+      xml << "<simulation>" << endl;
+      break;
+
+    case SimTraceRecord::SimulationEnd:
+      xml << "</simulation>" << endl;
+      break;
+
+    case SimTraceRecord::Ply: {
+      const LetterString rack((const char *)record.rack, record.rackLength);
+      xml << "\t\t<ply index=\"" << record.ply << "\">" << endl;
+      xml << "\t\t\t" << Rack(rack).xml() << endl;
+      xml << "\t\t\t" << record.move.toMove().xml() << endl;
+      if (record.flags & SimTraceRecord::HasPlayerConsideration)
+        xml << "\t\t\t<pc value=\"" << record.value << "\" />" << endl;
+      if (record.flags & SimTraceRecord::HasSharedConsideration)
+        xml << "\t\t\t<sc value=\"" << record.sharedConsideration << "\" />"
+            << endl;
+      xml << "\t\t</ply>" << endl;
+      break;
+    }
+
+    case SimTraceRecord::Playahead:
+      xml << "\t\t<playahead>" << endl;
+      if (record.flags & SimTraceRecord::GameOver)
+        xml << "\t\t\t<gameover win=\"" << record.value << "\" />" << endl;
+      xml << "\t\t</playahead>" << endl;
+      break;
+
+    case SimTraceRecord::IterationEnd:
+      break;
+    }
+  }
+
+  if (inIteration)
+    xml << "\t</iteration>" << endl;
+}
+
+bool Quackle::convertSimTraceToXml(const string &traceFilename,
+                                   const string &xmlFilename) {
+  ifstream trace(traceFilename.c_str(), ios::in | ios::binary);
+  if (!trace.is_open()) {
+    cerr << "Could not open " << traceFilename << " to read simulation trace"
+         << endl;
+    return false;
+  }
+
+  SimTraceRecord record;
+  if (!trace.read(reinterpret_cast<char *>(&record), sizeof(record)) ||
+      !record.isValidFileHeader()) {
+    cerr << traceFilename << " is not a simulation trace of version "
+         << SimTraceRecord::Version << endl;
+    return false;
+  }
+
+  UVOFStream xml(xmlFilename.c_str());
+  if (!xml.is_open()) {
+    cerr << "Could not open " << xmlFilename << " to write simulation log"
+         << endl;
+    return false;
+  }
+
+  // Records wait here, by order, until an IterationEnd or
+  // SimulationEnd says their iteration is complete; only the iterations
+  // the simulator had in flight are held at once. Each run of records
+  // appended after a header is written out on its own.
+  std::map<int, vector<SimTraceRecord>> pending;
+  const auto flush = [&](int lastOrder) {
+    vector<SimTraceRecord> records;
+    auto it = pending.begin();
+    for (; it != pending.end() && it->first <= lastOrder; ++it)
+      records.insert(records.end(), it->second.begin(), it->second.end());
+    pending.erase(pending.begin(), it);
+    writeXml(records, xml);
+  };
+
+  while (trace.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+    switch (record.type) {
+    case SimTraceRecord::FileHeader:
+      if (!record.isValidFileHeader()) {
+        cerr << traceFilename << " has a corrupt header" << endl;
+        return false;
+      }
+      flush(std::numeric_limits<int>::max());
+      break;
+
+    case SimTraceRecord::IterationEnd:
+      flush(record.order);
+      break;
+
+    case SimTraceRecord::SimulationEnd:
+      pending[record.order].push_back(record);
+      flush(record.order);
+      break;
+
+    default:
+      pending[record.order].push_back(record);
+      break;
+    }
+  }
+
+  flush(std::numeric_limits<int>::max());
+  return true;
+}
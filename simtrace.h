@@ -0,0 +1,164 @@
+/*
+ *  Quackle -- Crossword game artificial intelligence and analysis tool
+ *  Copyright (C) 2005-2019 Jason Katz-Brown, John O'Laughlin, and John Fultz.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QUACKLE_SIMTRACE_H
+#define QUACKLE_SIMTRACE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "movesink.h"
+
+using std::string;
+using std::vector;
+
+namespace Quackle {
+
+// One fixed-size entry of a simulation trace, written as is in native
+// byte order. The simulation threads write them in whatever order they
+// finish; order, candidate and ply put them back in the order of the
+// XML log they stand for. Every field is of a fixed width so that the
+// layout is the same wherever the trace is written.
+struct SimTraceRecord {
+  enum Type : unsigned char {
+    // starts each run of records appended to a file
+    FileHeader,
+    SimulationStart,
+    SimulationEnd,
+    // a ply of a playahead: the rack, the move and any residuals
+    Ply,
+    // the end of a playahead, and its result if the game ended
+    Playahead,
+    // every record of iteration order comes before this in the file
+    IterationEnd
+  };
+
+  enum Flag : unsigned char {
+    HasPlayerConsideration = 1,
+    HasSharedConsideration = 2,
+    GameOver = 4
+  };
+
+  enum { Version = 2, MaximumRackLength = 16 };
+
+  SimTraceRecord();
+
+  // a FileHeader record
+  static SimTraceRecord fileHeader();
+  bool isValidFileHeader() const;
+
+  std::uint8_t type;
+  std::uint8_t flags;
+  std::uint8_t rackLength;
+
+  // how many iterations were started in the trace before this
+  // record's, or before the simulation's first for SimulationStart
+  // and last for SimulationEnd
+  std::int32_t order;
+  // the iteration's index in its simulation
+  std::int32_t iteration;
+  // the playahead's place among its iteration's
+  std::int32_t candidate;
+  std::int32_t ply;
+  std::int64_t candidateId;
+
+  // player consideration of a Ply, or wins of a Playahead
+  double value;
+  double sharedConsideration;
+
+  PackedMove move;
+  Letter rack[MaximumRackLength];
+};
+
+// Writes trace records to a file from a background thread. Each worker
+// queues records on a ring buffer of its own and carries on; the
+// thread drains the buffers into the file.
+class SimTraceWriter {
+public:
+  SimTraceWriter() = default;
+  SimTraceWriter(const SimTraceWriter &) = delete;
+  SimTraceWriter(SimTraceWriter &&) = delete;
+  ~SimTraceWriter();
+
+  // Close any file already open and start writing a FileHeader and
+  // then records from workers workers to filename. Returns false if
+  // filename can't be opened, or if append is true and filename holds
+  // something other than traces of this version.
+  bool open(const string &filename, bool append, size_t workers);
+
+  // write out all records queued so far and close the file
+  void close();
+
+  bool isOpen() const;
+
+  // Lay out buffers for workers workers, once everything queued so far
+  // is written. No worker may be writing meanwhile.
+  void setWorkerCount(size_t workers);
+
+  // Queue record to be written. Only worker may call this for worker;
+  // it waits if worker's buffer is full.
+  void write(size_t worker, const SimTraceRecord &record);
+
+private:
+  enum { RingSize = 1024 };
+
+  struct alignas(64) Ring {
+    SimTraceRecord records[RingSize];
+    // records before head are queued, and those before tail written
+    std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+  };
+
+  void startThread(size_t workers);
+  void stopThread();
+  void threadFunc();
+
+  // Write out what the rings held when drain started; returns whether
+  // there was anything. Any record queued, on whichever ring, before
+  // a record on the last ring is written before that record.
+  bool drain();
+
+  std::ofstream m_stream;
+  vector<std::unique_ptr<Ring>> m_rings;
+  std::thread m_thread;
+
+  // guards the waiting of the thread
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_stop = false;
+};
+
+inline bool SimTraceWriter::isOpen() const { return m_stream.is_open(); }
+
+// Read the records of the traces in traceFilename and write the XML
+// simulation log they record to xmlFilename. Moves and racks are shown
+// in the current alphabet. Returns false if a file can't be opened or
+// the trace isn't one this version writes.
+bool convertSimTraceToXml(const string &traceFilename,
+                          const string &xmlFilename);
+
+} // namespace Quackle
+
+#endif
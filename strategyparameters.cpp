@@ -16,9 +16,22 @@
  *  along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
 #include <iostream>
 #include <fstream>
 
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include "alphabetparameters.h"
 #include "boardparameters.h"
 #include "datamanager.h"
@@ -27,8 +40,156 @@
 using namespace Quackle;
 using namespace std;
 
+namespace
+{
+
+enum BundleTable
+{
+	Syn2Table,
+	WorthsTable,
+	VcPlaceTable,
+	BogowinTable,
+	SuperleavesTable,
+	BundleTableCount
+};
+
+// The start of a bundle. The tables follow, each at an offset that's
+// a multiple of bundleAlignment so that a mapped bundle can be read
+// in place, laid out as StrategyParameters keeps them.
+struct BundleHeader
+{
+	char magic[16];
+	uint32_t version;
+	uint32_t headerSize;
+	uint64_t alphabetHash;
+	uint64_t length;
+	int32_t letterCount;
+	// a bit for each BundleTable that was loaded
+	uint32_t tables;
+	int32_t vcPlaceStarts;
+	int32_t vcPlaceLengths;
+	int32_t superleaveSymbols;
+	int32_t superleaveMaximumLength;
+	uint64_t offsets[BundleTableCount];
+};
+
+const char bundleMagic[16] = "quacklestrategy";
+const uint32_t bundleVersion = 1;
+const uint64_t bundleAlignment = 64;
+
+uint64_t alignBundleOffset(uint64_t offset)
+{
+	return (offset + bundleAlignment - 1) / bundleAlignment * bundleAlignment;
+}
+
+// FNV-1a of the letters of the current alphabet, which syn2 and worths
+// are indexed by
+uint64_t alphabetHash()
+{
+	uint64_t hash = 14695981039346656037ULL;
+	const auto mix = [&hash](uint64_t value) { hash = (hash ^ value) * 1099511628211ULL; };
+
+	const Letter lastLetter = QUACKLE_ALPHABET_PARAMETERS->lastLetter();
+	mix(lastLetter);
+	for (int letter = QUACKLE_FIRST_LETTER; letter <= lastLetter; ++letter)
+	{
+		const UVString text = QUACKLE_ALPHABET_PARAMETERS->userVisible(letter);
+		for (const auto &character : text)
+			mix((uint64_t)character);
+		mix(0);
+	}
+
+	return hash;
+}
+
+// the text files a bundle is made from
+const char *const strategyTextFiles[] = { "syn2", "worths", "vcplace", "bogowin", "superleaves" };
+
+bool modificationTime(const string &filename, time_t &time)
+{
+	struct stat info;
+	if (stat(filename.c_str(), &info) != 0)
+		return false;
+
+	time = info.st_mtime;
+	return true;
+}
+
+// whether any of lexicon's strategy text files was changed after
+// bundle was written
+bool bundleIsStale(const string &lexicon, const string &bundle)
+{
+	time_t bundleTime;
+	if (!modificationTime(bundle, bundleTime))
+		return false;
+
+	for (const char *name : strategyTextFiles)
+	{
+		const string filename = DataManager::self()->findDataFile("strategy", lexicon, name);
+		time_t textTime;
+		if (!filename.empty() && modificationTime(filename, textTime) && textTime > bundleTime)
+		{
+			cerr << filename << " is newer than " << bundle << "; loading the text files instead" << endl;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Maps a whole file read-only; false where that isn't possible, in which
+// case the caller reads the file instead.
+bool mapBundleFile(const string &filename, const unsigned char *&data, size_t &length)
+{
+#if defined(_WIN32)
+	return false;
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size <= 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void *mapping = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+		return false;
+
+	data = (const unsigned char *)mapping;
+	length = info.st_size;
+	return true;
+#endif
+}
+
+void unmapBundleFile(const unsigned char *data, size_t length)
+{
+#if !defined(_WIN32)
+	munmap((void *)data, length);
+#endif
+}
+
+}
+
 StrategyParameters::StrategyParameters()
-	: m_hasSyn2(false)
+	: m_letterCount(0)
+	, m_syn2(0)
+	, m_tileWorths(0)
+	, m_vcPlaceStarts(0)
+	, m_vcPlaceLengths(0)
+	, m_vcPlace(0)
+	, m_bogowin(0)
+	, m_superleaveSymbols(0)
+	, m_superleaveMaximumLength(-1)
+	, m_superleaves(0)
+	, m_bundle(0)
+	, m_bundleLength(0)
+	, m_bundleMapped(false)
+	, m_hasSyn2(false)
 	, m_hasWorths(false)
 	, m_hasVcPlace(false)
 	, m_hasBogowin(false)
@@ -36,8 +197,26 @@ StrategyParameters::StrategyParameters()
 {
 }
 
+StrategyParameters::~StrategyParameters()
+{
+	unloadBundle();
+}
+
 void StrategyParameters::initialize(const string &lexicon)
 {
+	unloadBundle();
+
+	const string bundle = DataManager::self()->findDataFile("strategy", lexicon, "bundle");
+	if (!bundle.empty() && !bundleIsStale(lexicon, bundle) && loadBundle(bundle))
+		return;
+
+	initializeFromText(lexicon);
+}
+
+void StrategyParameters::initializeFromText(const string &lexicon)
+{
+	unloadBundle();
+
 	m_hasSyn2 = loadSyn2(DataManager::self()->findDataFile("strategy", lexicon, "syn2"));
 	m_hasWorths = loadWorths(DataManager::self()->findDataFile("strategy", lexicon, "worths"));
 	m_hasVcPlace = loadVcPlace(DataManager::self()->findDataFile("strategy", lexicon, "vcplace"));
@@ -45,11 +224,238 @@ void StrategyParameters::initialize(const string &lexicon)
 	m_hasSuperleaves = loadSuperleaves(DataManager::self()->findDataFile("strategy", lexicon, "superleaves")); 	
 }
 
+void StrategyParameters::unloadBundle()
+{
+	if (!m_bundle)
+		return;
+
+	if (m_bundleMapped)
+		unmapBundleFile(m_bundle, m_bundleLength);
+	vector<double>().swap(m_bundleBuffer);
+	m_bundle = 0;
+	m_bundleLength = 0;
+	m_bundleMapped = false;
+
+	// nothing may point into the bundle now
+	m_letterCount = 0;
+	m_syn2 = m_tileWorths = m_vcPlace = m_bogowin = 0;
+	m_vcPlaceStarts = m_vcPlaceLengths = 0;
+	m_superleaves = 0;
+	m_superleaveSymbols = 0;
+	m_superleaveMaximumLength = -1;
+	m_hasSyn2 = m_hasWorths = m_hasVcPlace = m_hasBogowin = m_hasSuperleaves = false;
+}
+
+bool StrategyParameters::loadBundle(const string &filename)
+{
+	unloadBundle();
+
+	if (mapBundleFile(filename, m_bundle, m_bundleLength))
+	{
+		m_bundleMapped = true;
+	}
+	else
+	{
+		ifstream file(filename.c_str(), ios::in | ios::binary | ios::ate);
+		if (!file.is_open())
+		{
+			cerr << "Could not open " << filename << " to load strategy bundle" << endl;
+			return false;
+		}
+
+		m_bundleLength = file.tellg();
+		m_bundleBuffer.resize(m_bundleLength / sizeof(double) + 1);
+		file.seekg(0);
+		file.read((char *)m_bundleBuffer.data(), m_bundleLength);
+		m_bundle = (const unsigned char *)m_bundleBuffer.data();
+		if (!file)
+		{
+			cerr << "Could not read " << filename << " to load strategy bundle" << endl;
+			unloadBundle();
+			return false;
+		}
+	}
+
+	BundleHeader header;
+	memset(&header, 0, sizeof(header));
+	bool valid = m_bundleLength >= sizeof(header);
+	if (valid)
+	{
+		memcpy(&header, m_bundle, sizeof(header));
+		valid = memcmp(header.magic, bundleMagic, sizeof(bundleMagic)) == 0 &&
+			header.version == bundleVersion && header.headerSize == sizeof(header) &&
+			header.length == m_bundleLength && header.alphabetHash == alphabetHash() &&
+			header.letterCount == QUACKLE_ALPHABET_PARAMETERS->lastLetter() + 1 &&
+			header.vcPlaceStarts >= 0 && header.vcPlaceStarts <= QUACKLE_MAXIMUM_BOARD_SIZE &&
+			header.vcPlaceLengths >= 0 && header.vcPlaceLengths <= QUACKLE_MAXIMUM_BOARD_SIZE &&
+			header.superleaveSymbols >= 0 && header.superleaveSymbols <= QUACKLE_FIRST_LETTER + QUACKLE_MAXIMUM_ALPHABET_SIZE &&
+			header.superleaveMaximumLength >= -1 && header.superleaveMaximumLength <= 16;
+	}
+
+	// the leaves setUpSuperleaveIndex would lay out, counted without
+	// overflowing on a bad header
+	double superleaveCount = 0;
+	if (valid && (header.tables & (1 << SuperleavesTable)))
+	{
+		double combinations = 1;
+		for (int length = 0; length <= header.superleaveMaximumLength; ++length)
+		{
+			if (length > 0)
+				combinations = combinations * (header.superleaveSymbols + length - 1) / length;
+			superleaveCount += combinations;
+		}
+	}
+
+	const double sizes[BundleTableCount] =
+	{
+		(double)header.letterCount * header.letterCount * sizeof(double),
+		(double)header.letterCount * sizeof(double),
+		(double)header.vcPlaceStarts * header.vcPlaceLengths * 128 * sizeof(double),
+		(double)m_bogowinArrayWidth * m_bogowinArrayHeight * sizeof(double),
+		superleaveCount * sizeof(float),
+	};
+
+	for (int table = 0; valid && table < BundleTableCount; ++table)
+	{
+		if (!(header.tables & (1 << table)) && table != Syn2Table && table != WorthsTable)
+			continue;
+		valid = header.offsets[table] % bundleAlignment == 0 && header.offsets[table] <= m_bundleLength &&
+			sizes[table] <= m_bundleLength - header.offsets[table];
+	}
+
+	if (!valid)
+	{
+		cerr << filename << " is not a strategy bundle of version " << bundleVersion << " for this alphabet" << endl;
+		unloadBundle();
+		return false;
+	}
+
+	m_hasSyn2 = header.tables & (1 << Syn2Table);
+	m_hasWorths = header.tables & (1 << WorthsTable);
+	m_hasVcPlace = header.tables & (1 << VcPlaceTable);
+	m_hasBogowin = header.tables & (1 << BogowinTable);
+	m_hasSuperleaves = header.tables & (1 << SuperleavesTable);
+
+	// syn2 and worths are there, zero, even when they weren't loaded
+	m_letterCount = header.letterCount;
+	m_syn2 = (const double *)(m_bundle + header.offsets[Syn2Table]);
+	m_tileWorths = (const double *)(m_bundle + header.offsets[WorthsTable]);
+
+	m_vcPlaceStarts = m_hasVcPlace ? header.vcPlaceStarts : 0;
+	m_vcPlaceLengths = m_hasVcPlace ? header.vcPlaceLengths : 0;
+	m_vcPlace = m_hasVcPlace ? (const double *)(m_bundle + header.offsets[VcPlaceTable]) : 0;
+
+	m_bogowin = m_hasBogowin ? (const double *)(m_bundle + header.offsets[BogowinTable]) : 0;
+
+	if (m_hasSuperleaves)
+	{
+		setUpSuperleaveIndex(header.superleaveSymbols, header.superleaveMaximumLength);
+		m_superleaves = (const float *)(m_bundle + header.offsets[SuperleavesTable]);
+	}
+
+	// keep no copies of tables loaded from text before
+	vector<double>().swap(m_syn2Values);
+	vector<double>().swap(m_tileWorthValues);
+	vector<double>().swap(m_vcPlaceValues);
+	vector<double>().swap(m_bogowinValues);
+	vector<float>().swap(m_superleaveValues);
+
+	return true;
+}
+
+bool StrategyParameters::writeBundle(const string &filename) const
+{
+	if (!m_syn2 || !m_tileWorths)
+	{
+		cerr << "No strategy is loaded to write to " << filename << endl;
+		return false;
+	}
+
+	BundleHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, bundleMagic, sizeof(bundleMagic));
+	header.version = bundleVersion;
+	header.headerSize = sizeof(header);
+	header.alphabetHash = alphabetHash();
+	header.letterCount = m_letterCount;
+	header.vcPlaceStarts = m_hasVcPlace ? m_vcPlaceStarts : 0;
+	header.vcPlaceLengths = m_hasVcPlace ? m_vcPlaceLengths : 0;
+	header.superleaveSymbols = m_hasSuperleaves ? m_superleaveSymbols : 0;
+	header.superleaveMaximumLength = m_hasSuperleaves ? m_superleaveMaximumLength : -1;
+
+	// syn2 and worths go in whether they were loaded or not, as their
+	// zeroes are still looked up
+	header.tables = (m_hasSyn2 ? 1 << Syn2Table : 0) | (m_hasWorths ? 1 << WorthsTable : 0) |
+		(m_hasVcPlace ? 1 << VcPlaceTable : 0) | (m_hasBogowin && m_bogowin ? 1 << BogowinTable : 0) |
+		(m_hasSuperleaves && m_superleaves ? 1 << SuperleavesTable : 0);
+
+	const void *tables[BundleTableCount] = { m_syn2, m_tileWorths, m_vcPlace, m_bogowin, m_superleaves };
+	const uint64_t sizes[BundleTableCount] =
+	{
+		(uint64_t)m_letterCount * m_letterCount * sizeof(double),
+		(uint64_t)m_letterCount * sizeof(double),
+		(uint64_t)header.vcPlaceStarts * header.vcPlaceLengths * 128 * sizeof(double),
+		(header.tables & (1 << BogowinTable)) ? (uint64_t)m_bogowinArrayWidth * m_bogowinArrayHeight * sizeof(double) : 0,
+		(header.tables & (1 << SuperleavesTable)) ? (uint64_t)m_superleaveOffsets.back() * sizeof(float) : 0,
+	};
+
+	uint64_t offset = alignBundleOffset(sizeof(header));
+	for (int table = 0; table < BundleTableCount; ++table)
+	{
+		header.offsets[table] = offset;
+		offset = alignBundleOffset(offset + sizes[table]);
+	}
+	header.length = offset;
+
+	// filename may be the very bundle the tables are mapped from
+	const string temporaryFilename = filename + ".tmp";
+	ofstream file(temporaryFilename.c_str(), ios::out | ios::binary | ios::trunc);
+	if (!file.is_open())
+	{
+		cerr << "Could not open " << temporaryFilename << " to write strategy bundle" << endl;
+		return false;
+	}
+
+	file.write((const char *)&header, sizeof(header));
+	const vector<char> padding(bundleAlignment, 0);
+	uint64_t written = sizeof(header);
+	for (int table = 0; table < BundleTableCount; ++table)
+	{
+		file.write(padding.data(), header.offsets[table] - written);
+		if (sizes[table])
+			file.write((const char *)tables[table], sizes[table]);
+		written = header.offsets[table] + sizes[table];
+	}
+	file.write(padding.data(), header.length - written);
+	file.close();
+
+	if (!file)
+	{
+		cerr << "Could not write strategy bundle to " << temporaryFilename << endl;
+		remove(temporaryFilename.c_str());
+		return false;
+	}
+
+#if defined(_WIN32)
+	// rename won't replace a file here
+	remove(filename.c_str());
+#endif
+
+	if (rename(temporaryFilename.c_str(), filename.c_str()) != 0)
+	{
+		cerr << "Could not move strategy bundle " << temporaryFilename << " to " << filename << endl;
+		remove(temporaryFilename.c_str());
+		return false;
+	}
+
+	return true;
+}
+
 bool StrategyParameters::loadSyn2(const string &filename)
 {
-	for (int i = 0; i < QUACKLE_FIRST_LETTER + QUACKLE_MAXIMUM_ALPHABET_SIZE; ++i)
-		for (int j = 0; j < QUACKLE_FIRST_LETTER + QUACKLE_MAXIMUM_ALPHABET_SIZE; ++j)
-			m_syn2[i][j] = 0;
+	m_letterCount = QUACKLE_ALPHABET_PARAMETERS->lastLetter() + 1;
+	m_syn2Values.assign(m_letterCount * m_letterCount, 0);
+	m_syn2 = m_syn2Values.data();
 
 	UVIFStream file(filename.c_str());
 
@@ -80,8 +486,8 @@ bool StrategyParameters::loadSyn2(const string &filename)
 		double value;
 		file >> value;
 
-		m_syn2[(int)letterString[0]][(int)letterString[1]] = value;
-		m_syn2[(int)letterString[1]][(int)letterString[0]] = value;
+		m_syn2Values[letterString[0] * m_letterCount + letterString[1]] = value;
+		m_syn2Values[letterString[1] * m_letterCount + letterString[0]] = value;
 	}
 
 	file.close();
@@ -90,9 +496,8 @@ bool StrategyParameters::loadSyn2(const string &filename)
 
 bool StrategyParameters::loadBogowin(const string &filename)
 {
-	for (int i = 0; i < m_bogowinArrayWidth; ++i)
-		for (int j = 0; j < m_bogowinArrayHeight; ++j)
-			m_bogowin[i][j] = 0;
+	vector<double>().swap(m_bogowinValues);
+	m_bogowin = 0;
 
 	UVIFStream file(filename.c_str());
 
@@ -102,6 +507,9 @@ bool StrategyParameters::loadBogowin(const string &filename)
 		return false;
 	}
 
+	m_bogowinValues.assign(m_bogowinArrayWidth * m_bogowinArrayHeight, 0);
+	m_bogowin = m_bogowinValues.data();
+
 	while (!file.eof())
 	{
 		int lead, unseen;
@@ -111,7 +519,8 @@ bool StrategyParameters::loadBogowin(const string &filename)
 		file >> unseen;
 		file >> wins;
 		
-		m_bogowin[lead + 300][unseen] = wins;
+		if (lead >= -300 && lead <= 300 && unseen >= 0 && unseen < m_bogowinArrayHeight)
+			m_bogowinValues[(lead + 300) * m_bogowinArrayHeight + unseen] = wins;
 	}
 	
 	file.close();
@@ -120,8 +529,9 @@ bool StrategyParameters::loadBogowin(const string &filename)
 
 bool StrategyParameters::loadWorths(const string &filename)
 {
-	for (int i = 0; i < QUACKLE_FIRST_LETTER + QUACKLE_MAXIMUM_ALPHABET_SIZE; ++i)
-		m_tileWorths[i] = 0;
+	m_letterCount = QUACKLE_ALPHABET_PARAMETERS->lastLetter() + 1;
+	m_tileWorthValues.assign(m_letterCount, 0);
+	m_tileWorths = m_tileWorthValues.data();
 
 	UVIFStream file(filename.c_str());
 
@@ -152,7 +562,7 @@ bool StrategyParameters::loadWorths(const string &filename)
 		double value;
 		file >> value;
 
-		m_tileWorths[(int)letterString[0]] = value;
+		m_tileWorthValues[letterString[0]] = value;
 	}
 
 	file.close();
@@ -161,10 +571,10 @@ bool StrategyParameters::loadWorths(const string &filename)
 
 bool StrategyParameters::loadVcPlace(const string &filename)
 {
-	for (int i = 0; i < QUACKLE_MAXIMUM_BOARD_SIZE; ++i)
-		for (int j = 0; j < QUACKLE_MAXIMUM_BOARD_SIZE; ++j)
-			for (int k = 0; k < 128; ++k)
-				m_vcPlace[i][j][k] = 0;
+	vector<double>().swap(m_vcPlaceValues);
+	m_vcPlace = 0;
+	m_vcPlaceStarts = 0;
+	m_vcPlaceLengths = 0;
 
 	UVIFStream file(filename.c_str());
 
@@ -174,6 +584,13 @@ bool StrategyParameters::loadVcPlace(const string &filename)
 		return false;
 	}
 
+	struct Placement
+	{
+		unsigned int start, length, consbits;
+		double value;
+	};
+	vector<Placement> placements;
+
 	while (!file.eof())
 	{
 		unsigned int start;
@@ -200,17 +617,52 @@ bool StrategyParameters::loadVcPlace(const string &filename)
 		if ((start < QUACKLE_MAXIMUM_BOARD_SIZE) && 
 			(length < QUACKLE_MAXIMUM_BOARD_SIZE) &&
 			(consbits < 128))
-
-		m_vcPlace[start][length][consbits] = value;
+		{
+			Placement placement = { start, length, consbits, value };
+			placements.push_back(placement);
+			m_vcPlaceStarts = max(m_vcPlaceStarts, (int)start + 1);
+			m_vcPlaceLengths = max(m_vcPlaceLengths, (int)length + 1);
+		}
 	}
 
 	file.close();
+
+	// only as big as the placements in the file need
+	m_vcPlaceValues.assign(m_vcPlaceStarts * m_vcPlaceLengths * 128, 0);
+	for (const auto &placement : placements)
+		m_vcPlaceValues[(placement.start * m_vcPlaceLengths + placement.length) * 128 + placement.consbits] = placement.value;
+	m_vcPlace = m_vcPlaceValues.data();
+
 	return true;	
 }
 
+void StrategyParameters::setUpSuperleaveIndex(int symbols, int maximumLength)
+{
+	m_superleaveSymbols = symbols;
+	m_superleaveMaximumLength = maximumLength;
+
+	const int width = maximumLength + 1;
+	const int rows = symbols + maximumLength;
+	m_superleaveBinomials.assign(rows * width, 0);
+	for (int n = 0; n < rows; ++n)
+	{
+		m_superleaveBinomials[n * width] = 1;
+		for (int k = 1; k <= maximumLength && k <= n; ++k)
+			m_superleaveBinomials[n * width + k] = m_superleaveBinomials[(n - 1) * width + k - 1] + (k < n ? m_superleaveBinomials[(n - 1) * width + k] : 0);
+	}
+
+	// there are (symbols + length - 1) choose length leaves of length
+	m_superleaveOffsets.assign(maximumLength + 2, 0);
+	for (int length = 0; length <= maximumLength; ++length)
+		m_superleaveOffsets[length + 1] = m_superleaveOffsets[length] + (length == 0 ? 1 : superleaveBinomial(symbols + length - 1, length));
+}
+
 bool StrategyParameters::loadSuperleaves(const string &filename)
 {
-	m_superleaves.clear();
+	vector<float>().swap(m_superleaveValues);
+	m_superleaves = 0;
+	m_superleaveSymbols = 0;
+	m_superleaveMaximumLength = -1;
 
 	ifstream file(filename.c_str(), ios::in | ios::binary);
 
@@ -226,9 +678,15 @@ bool StrategyParameters::loadSuperleaves(const string &filename)
 	unsigned char intvaluefrac;
 	unsigned int intvalue;
 
+	vector<pair<LetterString, double> > leaves;
+	Letter lastLetter = QUACKLE_BLANK_MARK;
+	int maximumLength = 0;
+
 	while (!file.eof())
 	{
 		file.read((char*)(&leavesize), 1);
+		if (leavesize > sizeof(leavebytes))
+			break;
 		file.read(leavebytes, leavesize);
 		file.read((char*)(&intvaluefrac), 1);
 		file.read((char*)(&intvalueint), 1);
@@ -239,10 +697,25 @@ bool StrategyParameters::loadSuperleaves(const string &filename)
 		LetterString leave = LetterString(leavebytes, leavesize);
 	
 		double value = (double(intvalue) / 256.0) - 128.0;
-		m_superleaves.insert(m_superleaves.end(),
-				     SuperLeavesMap::value_type(leave, value));
+		leaves.push_back(make_pair(String::alphabetize(leave), value));
+
+		for (const auto &letter : leave)
+			lastLetter = max(lastLetter, (Letter)letter);
+		maximumLength = max(maximumLength, (int)leave.length());
 	}
 	
 	file.close();
+
+	// lay the leaves out flat, ranked so each is found without a search
+	setUpSuperleaveIndex(max(lastLetter - QUACKLE_FIRST_LETTER + 2, 1), maximumLength);
+	m_superleaveValues.assign(m_superleaveOffsets[maximumLength + 1], 0);
+	for (const auto &leave : leaves)
+	{
+		const int index = superleaveIndex(leave.first);
+		if (index >= 0)
+			m_superleaveValues[index] = (float)leave.second;
+	}
+	m_superleaves = m_superleaveValues.data();
+
 	return true;	
 }
@@ -19,7 +19,7 @@
 #ifndef QUACKLE_STRATEGYPARAMETERS_H
 #define QUACKLE_STRATEGYPARAMETERS_H
 
-#include <map>
+#include <vector>
 #include "alphabetparameters.h"
 
 namespace Quackle
@@ -29,8 +29,34 @@ class StrategyParameters
 {
 public:
 	StrategyParameters();
-
+	StrategyParameters(const StrategyParameters &) = delete;
+	StrategyParameters &operator=(const StrategyParameters &) = delete;
+	~StrategyParameters();
+
+	// Loads strategy/<lexicon>/bundle, found as the other strategy
+	// files are, if it is one for the current alphabet, and otherwise
+	// the syn2, worths, vcplace, bogowin and superleaves files. A
+	// bundle older than any of those files is passed over, with a
+	// warning, so that edits to them aren't hidden by a stale bundle.
 	void initialize(const string &lexicon);
+
+	// Loads the syn2, worths, vcplace, bogowin and superleaves files
+	// whether or not there is a bundle, as a bundle is made from.
+	void initializeFromText(const string &lexicon);
+
+	// Load every table from a bundle that writeBundle wrote, mapping
+	// it into memory where possible. Returns false, leaving nothing
+	// loaded, if filename can't be read or isn't a bundle of this
+	// version for the current alphabet.
+	bool loadBundle(const string &filename);
+
+	// Write the tables loaded now to filename as a bundle, in native
+	// byte order. The bundle is written beside filename and renamed
+	// over it once complete, so filename is never left half written.
+	// Returns false if filename can't be written or nothing has been
+	// loaded.
+	bool writeBundle(const string &filename) const;
+
 	bool hasSyn2() const;
 	bool hasWorths() const;
 	bool hasVcPlace() const;
@@ -42,7 +68,9 @@ public:
 	double tileWorth(Letter letter) const;
 	double vcPlace(int start, int length, int consbits);
 	double bogowin(int lead, int unseen, int blanks);
-	double superleave(LetterString leave);
+
+	// value of an alphabetized leave, or zero if there is none
+	double superleave(const LetterString &leave) const;
 	
 protected:
 	bool loadSyn2(const string &filename);
@@ -50,18 +78,59 @@ protected:
 	bool loadVcPlace(const string &filename);
 	bool loadBogowin(const string &filename);
 	bool loadSuperleaves(const string &filename);
+
+	void unloadBundle();
 	
 	int mapLetter(Letter letter) const;
 
-	double m_syn2[QUACKLE_FIRST_LETTER + QUACKLE_MAXIMUM_ALPHABET_SIZE][QUACKLE_FIRST_LETTER + QUACKLE_MAXIMUM_ALPHABET_SIZE];
-	double m_tileWorths[QUACKLE_FIRST_LETTER + QUACKLE_MAXIMUM_ALPHABET_SIZE];
-	double m_vcPlace[QUACKLE_MAXIMUM_BOARD_SIZE][QUACKLE_MAXIMUM_BOARD_SIZE][128];
+	// Where leave's value is in m_superleaves, or -1 if it can't be
+	// there. The leaves of each length come after all shorter ones, in
+	// the order of their letters; a leave's place among those of its
+	// length is its rank as a combination with repetition.
+	int superleaveIndex(const LetterString &leave) const;
+	void setUpSuperleaveIndex(int symbols, int maximumLength);
+	int superleaveBinomial(int n, int k) const;
+
+	// The tables point into the vectors below when loaded from text
+	// files, and into m_bundle when loaded from a bundle.
+
+	// letters the syn2 and worths tables are wide, blank included
+	int m_letterCount;
+	const double *m_syn2;
+	const double *m_tileWorths;
+
+	// by start, then length, then consbits, with as many starts and
+	// lengths as the file has
+	int m_vcPlaceStarts;
+	int m_vcPlaceLengths;
+	const double *m_vcPlace;
 
 	static const int m_bogowinArrayWidth = 601;
 	static const int m_bogowinArrayHeight = 94;
-	double m_bogowin[m_bogowinArrayWidth][m_bogowinArrayHeight];
-	typedef std::map<LetterString, double> SuperLeavesMap;
-	SuperLeavesMap m_superleaves;
+	const double *m_bogowin;
+
+	// blank and letters counted from the first letter the file has
+	int m_superleaveSymbols;
+	int m_superleaveMaximumLength;
+	// where the leaves of each length start
+	std::vector<int> m_superleaveOffsets;
+	std::vector<int> m_superleaveBinomials;
+	// values are multiples of 1/256 below 256 in magnitude, which
+	// floats hold exactly
+	const float *m_superleaves;
+
+	std::vector<double> m_syn2Values;
+	std::vector<double> m_tileWorthValues;
+	std::vector<double> m_vcPlaceValues;
+	std::vector<double> m_bogowinValues;
+	std::vector<float> m_superleaveValues;
+
+	// the bundle, mapped or else read into m_bundleBuffer
+	const unsigned char *m_bundle;
+	size_t m_bundleLength;
+	bool m_bundleMapped;
+	std::vector<double> m_bundleBuffer;
+
 	bool m_hasSyn2;
 	bool m_hasWorths;
 	bool m_hasVcPlace;
@@ -102,7 +171,7 @@ inline int StrategyParameters::mapLetter(Letter letter) const
 
 inline double StrategyParameters::syn2(Letter letter1, Letter letter2) const
 {
-	return m_syn2[mapLetter(letter1)][mapLetter(letter2)];
+	return m_syn2[mapLetter(letter1) * m_letterCount + mapLetter(letter2)];
 }
 
 inline double StrategyParameters::tileWorth(Letter letter) const
@@ -113,11 +182,11 @@ inline double StrategyParameters::tileWorth(Letter letter) const
 inline double StrategyParameters::vcPlace(int start, int length, int consbits)
 {
 	if ((consbits < 0) || (consbits >= 128) || 
-		(start < 0) || (start >= QUACKLE_MAXIMUM_BOARD_SIZE) ||
-		(length < 0) || (length >= QUACKLE_MAXIMUM_BOARD_SIZE))
+		(start < 0) || (start >= m_vcPlaceStarts) ||
+		(length < 0) || (length >= m_vcPlaceLengths))
 		return 0;
 
-	return m_vcPlace[start][length][consbits];
+	return m_vcPlace[(start * m_vcPlaceLengths + length) * 128 + consbits];
 }
 
 inline double StrategyParameters::bogowin(int lead, int unseen, int /* blanks */)
@@ -133,15 +202,44 @@ inline double StrategyParameters::bogowin(int lead, int unseen, int /* blanks */
 		else if (lead == 0) return 0.5;
 		else return 1;
 	}
+
+	if (!m_bogowin) return 0;
 	
-	return m_bogowin[lead + 300][unseen];
+	return m_bogowin[(lead + 300) * m_bogowinArrayHeight + unseen];
+}
+
+inline int StrategyParameters::superleaveBinomial(int n, int k) const
+{
+	return m_superleaveBinomials[n * (m_superleaveMaximumLength + 1) + k];
+}
+
+inline int StrategyParameters::superleaveIndex(const LetterString &leave) const
+{
+	const int length = leave.length();
+	if (length > m_superleaveMaximumLength)
+		return -1;
+
+	// the letters plus their positions are a combination without
+	// repetition, ranked by the combinatorial number system
+	int index = m_superleaveOffsets[length];
+	int previous = 0;
+	for (int i = 0; i < length; ++i)
+	{
+		const Letter letter = leave[i];
+		const int symbol = letter == QUACKLE_BLANK_MARK ? 0 : letter - QUACKLE_FIRST_LETTER + 1;
+		if (symbol < previous || symbol >= m_superleaveSymbols)
+			return -1;
+		previous = symbol;
+		index += superleaveBinomial(symbol + i, i + 1);
+	}
+
+	return index;
 }
 
-inline double StrategyParameters::superleave(LetterString leave)
+inline double StrategyParameters::superleave(const LetterString &leave) const
 {
-	if (leave.length() == 0)
-		return 0.0;
-	return m_superleaves[leave];
+	const int index = superleaveIndex(leave);
+	return index < 0 ? 0.0 : m_superleaves[index];
 }
 
 }